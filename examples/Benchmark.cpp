@@ -0,0 +1,393 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+/*
+ * Benchmark - measures the cost of the library's hot paths without a network.
+ * compress: gzip the files of the public folder with the levels 1..9 and print
+ *           the CPU time spent per megabyte against the bytes saved.
+ * alloc:    feed a typical GET request through the session manager and a response
+ *           and print the heap allocations per request with and without the object pools.
+ * mask:     (un)mask WebSocket payloads of 1 KB, 64 KB and 16 MB and print the throughput
+ *           of a byte-by-byte loop against the vectorized kernel.
+ * fanout:   queue one 1 KB message for 10k subscribed connections of a WebSocketServer with
+ *           SendResponse() per connection against Broadcast(), and print the time and the
+ *           allocations per broadcast. The sockets are not written.
+*/
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <atomic>
+#include <algorithm>
+#include <new>
+#include <cstdlib>
+#include "common_webcpp.h"
+#include "FileSystem.h"
+#include "File.h"
+#include "Data.h"
+#include "StringUtil.h"
+#include "SessionManager.h"
+#include "Response.h"
+#include "ResponseWebSocket.h"
+#include "WebSocketServer.h"
+#include "HttpConfig.h"
+#include "example_common.h"
+
+#define DEFAULT_MODE "compress"
+#define DEFAULT_ITERATIONS 20
+#define ALLOC_REQUESTS 10000
+#define MASK_TOTAL_SIZE (256_Mb)
+#define FANOUT_CONNECTIONS 10000
+#define FANOUT_MESSAGE_SIZE (1_Kb)
+
+
+int iterations = DEFAULT_ITERATIONS;
+static std::atomic<size_t> allocations(0);
+
+void *operator new(size_t size)
+{
+    allocations ++;
+    void *ptr = std::malloc(size == 0 ? 1 : size);
+    if(ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+#ifdef WITH_ZLIB
+static ByteArray LoadFile(const std::string &path)
+{
+    ByteArray data(WebCpp::FileSystem::GetFileSize(path));
+    WebCpp::File file(path, WebCpp::File::Mode::Read);
+    size_t pos = 0;
+    while(file.IsOpened() && pos < data.size())
+    {
+        ssize_t bytes = file.Read(reinterpret_cast<char *>(data.data()) + pos, data.size() - pos);
+        if(bytes <= 0)
+        {
+            break;
+        }
+        pos += bytes;
+    }
+    data.resize(pos);
+
+    return data;
+}
+#endif
+
+static void BenchmarkCompress(const std::string &path)
+{
+#ifdef WITH_ZLIB
+    std::vector<ByteArray> files;
+    size_t total = 0;
+    std::string folder = WebCpp::FileSystem::NormalizePath(path);
+    for(auto &info: WebCpp::FileSystem::GetFolder(folder))
+    {
+        if(info.folder == false)
+        {
+            files.push_back(LoadFile(folder + info.name));
+            total += files.back().size();
+        }
+    }
+
+    std::cout << "files: " << files.size() << ", total size: " << total << " bytes, iterations: " << iterations << std::endl;
+    std::cout << "level      compressed      saved     µs/MB" << std::endl;
+
+    for(int level = 1;level <= 9;level ++)
+    {
+        size_t compressed = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(int i = 0;i < iterations;i ++)
+        {
+            compressed = 0;
+            for(auto &data: files)
+            {
+                compressed += Data::Zip(data, level).size();
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        double us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        double perMb = us / iterations / (static_cast<double>(total) / 1_Mb);
+
+        std::cout << std::setw(5) << level
+                  << std::setw(16) << compressed
+                  << std::setw(10) << std::fixed << std::setprecision(1) << (100.0 - 100.0 * compressed / total) << "%"
+                  << std::setw(10) << std::setprecision(0) << perMb
+                  << std::endl;
+    }
+#else
+    (void)path;
+    std::cout << "the library is built without zlib support" << std::endl;
+#endif
+}
+
+static double MeasureAllocations(size_t poolCapacity)
+{
+    static const std::string request = "GET /index.html?a=1&b=2 HTTP/1.1\r\n"
+                                       "Host: localhost:8080\r\n"
+                                       "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0\r\n"
+                                       "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+                                       "Accept-Language: en-US,en;q=0.5\r\n"
+                                       "Accept-Encoding: gzip, deflate, br\r\n"
+                                       "Connection: keep-alive\r\n"
+                                       "Cookie: session=0123456789abcdef0123456789abcdef\r\n\r\n";
+    ByteArray data(request.begin(), request.end());
+
+    WebCpp::SessionManager sessionManager;
+    sessionManager.GetRequestPool().SetCapacity(poolCapacity);
+    sessionManager.AddNewSession(1, "127.0.0.1:50000");
+    WebCpp::ObjectPool<WebCpp::Response> responsePool([]() { return new WebCpp::Response(1, WebCpp::HttpConfig::Instance()); });
+    responsePool.SetCapacity(poolCapacity);
+
+    auto handle = [&]()
+    {
+        sessionManager.AppendData(1, data);
+        sessionManager.Process();
+        auto request = sessionManager.GetReadyRequest();
+        auto response = responsePool.Get();
+        response->SetConnectionID(1);
+        response->AddHeader(WebCpp::HttpHeader::HeaderType::ContentType, "text/html");
+        response->Write("<html><body>Hello</body></html>");
+    };
+
+    // the first request warms up the pools and the session buffers
+    handle();
+
+    size_t start = allocations;
+    for(int i = 0;i < ALLOC_REQUESTS;i ++)
+    {
+        handle();
+    }
+
+    return static_cast<double>(allocations - start) / ALLOC_REQUESTS;
+}
+
+static void BenchmarkAlloc()
+{
+    std::cout << "requests: " << ALLOC_REQUESTS << std::endl;
+    std::cout << "pools           allocations/request" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "disabled" << std::setw(29) << MeasureAllocations(0) << std::endl;
+    std::cout << "enabled" << std::setw(30) << MeasureAllocations(DEFAULT_POOL_CAPACITY) << std::endl;
+}
+
+static void BenchmarkMask()
+{
+    static const uint8_t mask[4] = { 0x37, 0xfa, 0x21, 0x3d };
+    std::cout << "frame size     loop, MB/s    kernel, MB/s" << std::endl;
+
+    for(size_t size: { 1_Kb, 64_Kb, 16_Mb })
+    {
+        ByteArray src(size);
+        for(size_t i = 0;i < size;i ++)
+        {
+            src[i] = static_cast<uint8_t>(i);
+        }
+        ByteArray dst1(size), dst2(size);
+        size_t repeat = std::max<size_t>(1, MASK_TOTAL_SIZE / size);
+
+        auto start = std::chrono::steady_clock::now();
+        for(size_t n = 0;n < repeat;n ++)
+        {
+            for(size_t i = 0;i < size;i ++)
+            {
+                dst1[i] = src[i] ^ mask[i % 4];
+            }
+        }
+        auto loopTime = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        for(size_t n = 0;n < repeat;n ++)
+        {
+            Data::Mask(src.data(), dst2.data(), size, mask);
+        }
+        auto kernelTime = std::chrono::steady_clock::now() - start;
+
+        if(dst1 != dst2)
+        {
+            std::cout << "the kernel result doesn't match the loop result" << std::endl;
+            return;
+        }
+
+        double mb = static_cast<double>(size) * repeat / 1_Mb;
+        auto throughput = [mb](std::chrono::steady_clock::duration duration)
+        {
+            double seconds = std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 1000000.0;
+            return seconds > 0 ? mb / seconds : 0.0;
+        };
+
+        std::cout << std::setw(10) << size
+                  << std::setw(14) << std::fixed << std::setprecision(0) << throughput(loopTime)
+                  << std::setw(16) << throughput(kernelTime)
+                  << std::endl;
+    }
+}
+
+#ifdef WITH_WEBSOCKET
+// there are no real connections, the output slots are opened and subscribed directly
+class FanoutServer: public WebCpp::WebSocketServer
+{
+public:
+    void Open(int connID, const std::string &topic)
+    {
+        OpenOutput(connID, nullptr);
+        Subscribe(connID, topic);
+    }
+    void Drop(int connID)
+    {
+        CloseOutput(connID);
+    }
+};
+#endif
+
+static void BenchmarkFanout()
+{
+#ifdef WITH_WEBSOCKET
+    ByteArray message(FANOUT_MESSAGE_SIZE, 'x');
+    std::cout << "connections: " << FANOUT_CONNECTIONS << ", message size: " << message.size()
+              << " bytes, iterations: " << iterations << std::endl;
+    std::cout << "call             µs/broadcast    allocations/broadcast" << std::endl;
+
+    FanoutServer server;
+    const std::string topic = "fanout";
+
+    // the queued frames are dropped before every iteration as if they were written, that isn't timed
+    auto measure = [&](const std::string &name, const std::function<size_t()> &broadcast)
+    {
+        std::chrono::steady_clock::duration total(0);
+        size_t count = 0;
+        for(int i = 0;i < iterations;i ++)
+        {
+            for(int connID = 0;connID < FANOUT_CONNECTIONS;connID ++)
+            {
+                server.Drop(connID);
+                server.Open(connID, topic);
+            }
+
+            size_t start = allocations;
+            auto startTime = std::chrono::steady_clock::now();
+            size_t queued = broadcast();
+            total += std::chrono::steady_clock::now() - startTime;
+            count += allocations - start;
+
+            if(queued != FANOUT_CONNECTIONS)
+            {
+                std::cout << name << ": queued for " << queued << " connections only" << std::endl;
+                return;
+            }
+        }
+        double us = std::chrono::duration_cast<std::chrono::microseconds>(total).count();
+
+        std::cout << std::left << std::setw(16) << name << std::right
+                  << std::setw(14) << std::fixed << std::setprecision(0) << us / iterations
+                  << std::setw(25) << std::setprecision(1) << static_cast<double>(count) / iterations
+                  << std::endl;
+    };
+
+    // every connection gets its own response encoded
+    measure("SendResponse", [&]()
+    {
+        size_t queued = 0;
+        for(int connID = 0;connID < FANOUT_CONNECTIONS;connID ++)
+        {
+            WebCpp::ResponseWebSocket response(connID);
+            response.WriteText(message);
+            if(server.SendResponse(response))
+            {
+                queued ++;
+            }
+        }
+        return queued;
+    });
+
+    // the frame is encoded once and shared by the subscribers
+    measure("Broadcast", [&]()
+    {
+        return server.Broadcast(topic, message);
+    });
+#else
+    std::cout << "the library is built without websocket support" << std::endl;
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    auto cmdline = CommandLine::Parse(argc, argv);
+
+    if(cmdline.Exists("-h"))
+    {
+        std::vector<std::string> adds;
+        adds.push_back("-m: mode [compress, alloc, mask, fanout], default: " + std::string(DEFAULT_MODE));
+        adds.push_back("-f: folder with the test files, default: " + std::string(PUB));
+        adds.push_back("-n: count of iterations, default: " + std::to_string(DEFAULT_ITERATIONS));
+
+        cmdline.PrintUsage(false, false, adds);
+        exit(0);
+    }
+
+    std::string mode = DEFAULT_MODE;
+    cmdline.Set("-m", mode);
+
+    std::string folder = PUB;
+    cmdline.Set("-f", folder);
+
+    int v;
+    if(StringUtil::String2int(cmdline.Get("-n"), v) && v > 0)
+    {
+        iterations = v;
+    }
+
+    switch(_(mode.c_str()))
+    {
+        case _("compress"):
+            BenchmarkCompress(folder);
+            break;
+        case _("alloc"):
+            BenchmarkAlloc();
+            break;
+        case _("mask"):
+            BenchmarkMask();
+            break;
+        case _("fanout"):
+            BenchmarkFanout();
+            break;
+        default:
+            std::cout << "unknown mode: " << mode << std::endl;
+            return 1;
+    }
+
+    return 0;
+}
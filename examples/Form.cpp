@@ -24,9 +24,11 @@
 
 /*
  * Form - a simple HTTP server demonstrating POST message processing
+ * and a streamed upload
 */
 
 #include <csignal>
+#include <map>
 #include "common_webcpp.h"
 #include "HttpServer.h"
 #include "Request.h"
@@ -123,12 +125,31 @@ int main(int argc, char *argv[])
 
             response.AddHeader("Content-Type","text/html;charset=utf-8");
             response.Write("<div>Hello, " + body.GetValue("name").GetDataString() + " " + body.GetValue("surname").GetDataString() + "</div>");
-            response.Write("<div>file 1 '" + file1.fileName + "'" + " with length: " + std::to_string(file1.data.size()) + " and mimetype: '" + file1.contentType + "' was successfully uploaded</div>");
-            response.Write("<div>file 2 '" + file2.fileName + "'" + " with length: " + std::to_string(file2.data.size()) + " and mimetype: '" + file2.contentType + "' was successfully uploaded</div>");
+            response.Write("<div>file 1 '" + file1.fileName + "'" + " with length: " + std::to_string(file1.GetSize()) + " and mimetype: '" + file1.contentType + "' was successfully uploaded</div>");
+            response.Write("<div>file 2 '" + file2.fileName + "'" + " with length: " + std::to_string(file2.GetSize()) + " and mimetype: '" + file2.contentType + "' was successfully uploaded</div>");
 
             return retval;
         });
 
+        // the body of this request is handed over piece by piece and never kept in memory
+        std::map<int, size_t> uploaded;
+        httpServer.OnPostStream("/upload", [&uploaded](const WebCpp::Request &request, const uint8_t *, size_t size) -> bool
+        {
+            uploaded[request.GetConnectionID()] += size;
+            return true;
+        },
+        [&uploaded](const WebCpp::Request &request, WebCpp::Response &response) -> bool
+        {
+            size_t size = uploaded[request.GetConnectionID()];
+            uploaded.erase(request.GetConnectionID());
+            WebCpp::DebugPrint() << "OnPostStream(), received " << size << " bytes" << std::endl;
+
+            response.AddHeader("Content-Type","text/plain");
+            response.Write("received " + std::to_string(size) + " bytes");
+
+            return true;
+        });
+
         httpServer.Run();
         WebCpp::DebugPrint() << "Starting... Press Ctrl-C to terminate" << std::endl;
         httpServer.WaitFor();
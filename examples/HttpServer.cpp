@@ -24,6 +24,7 @@
 
 /*
  * HttpServer - a simple HTTP server demonstrating the processing of GET requests
+ * and a response streamed with the chunked transfer encoding
  *
 */
 
@@ -89,6 +90,32 @@ int main(int argc, char *argv[])
     if(httpServer.Init())
     {
         WebCpp::DebugPrint() << "HTTP simple test server" << std::endl;
+        httpServer.OnGet("/stream/{count}", [](const WebCpp::Request &request, WebCpp::Response &response) -> bool
+        {
+            int count;
+            if(StringUtil::String2int(request.GetArg("count"), count) == false)
+            {
+                return false;
+            }
+
+            WebCpp::DebugPrint() << "OnGet(), stream " << count << " lines" << std::endl;
+
+            response.AddHeader(WebCpp::HttpHeader::HeaderType::ContentType, "text/plain");
+            response.SetStreamFunction([count](WebCpp::Response::Writer &writer) -> bool
+            {
+                for(int i = 0;i < count;i ++)
+                {
+                    if(writer.Write("line " + std::to_string(i) + "\n") == false)
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            });
+
+            return true;
+        });
+
         httpServer.OnGet("/[{file}]", [](const WebCpp::Request &request, WebCpp::Response &response) -> bool
         {
             std::string file = request.GetArg("file");
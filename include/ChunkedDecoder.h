@@ -0,0 +1,76 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef WEBCPP_CHUNKED_DECODER_H
+#define WEBCPP_CHUNKED_DECODER_H
+
+#include "common_webcpp.h"
+#include "IErrorable.h"
+
+
+namespace WebCpp
+{
+
+/**
+ * @brief The ChunkedDecoder class is an incremental decoder of 'Transfer-Encoding: chunked' body.
+ * The body is decoded in place, the chunk framing is removed from the buffer
+ * so the decoded data occupies the same memory that was used by the received one
+ */
+class ChunkedDecoder: public IErrorable
+{
+public:
+    ChunkedDecoder(size_t maxSize = SIZE_MAX);
+    ChunkedDecoder(const ChunkedDecoder &other) = delete;
+    ChunkedDecoder& operator=(const ChunkedDecoder &other) = delete;
+
+    bool Decode(ByteArray &data, size_t start, size_t &decoded);
+    bool IsComplete() const;
+    bool IsTooLarge() const;
+    size_t GetSize() const;
+    const ByteArray& GetTrailer() const;
+
+protected:
+    enum class State
+    {
+        Size,
+        Data,
+        DataEnd,
+        Trailer,
+        Complete,
+    };
+
+    bool ParseSize(const ByteArray &data, size_t start, size_t end);
+
+private:
+    State m_state = State::Size;
+    size_t m_maxSize;
+    size_t m_size = 0;
+    size_t m_remaining = 0;
+    bool m_tooLarge = false;
+    ByteArray m_trailer;
+};
+
+}
+
+#endif // WEBCPP_CHUNKED_DECODER_H
@@ -0,0 +1,103 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef WEBCPP_FILECACHE_H
+#define WEBCPP_FILECACHE_H
+
+#include <string>
+#include <list>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include "common_webcpp.h"
+#include "HttpConfig.h"
+#include "Mutex.h"
+
+
+namespace WebCpp
+{
+
+class FileCache
+{
+public:
+    struct Entry
+    {
+        std::string key;
+        std::string path;
+        std::string root;
+        std::string mimeType;
+        std::string lastModified;
+        std::string etag;
+        size_t size = 0;
+        time_t modified = 0;
+        uint64_t inode = 0;
+        bool cached = false;
+        ByteArray content;
+        mutable std::map<std::string, std::shared_ptr<const ByteArray>> encoded;
+        std::map<std::string, std::shared_ptr<const Entry>> precompressed;
+    };
+    using EntryPtr = std::shared_ptr<const Entry>;
+    using EncodedPtr = std::shared_ptr<const ByteArray>;
+
+    static FileCache& Instance();
+    FileCache(const FileCache& other) = delete;
+    FileCache& operator=(const FileCache& other) = delete;
+    FileCache(FileCache&& other) = delete;
+    FileCache& operator=(FileCache&& other) = delete;
+
+    EntryPtr Get(const std::string &file, const HttpConfig &config);
+    EncodedPtr GetEncoded(const EntryPtr &entry, const std::string &encoding, const HttpConfig &config);
+    void Remove(const std::string &file);
+    void Clear();
+    size_t GetSize() const;
+    size_t GetCount() const;
+
+    static std::string BuildETag(uint64_t inode, size_t size, time_t modified);
+
+protected:
+    FileCache() = default;
+    static EntryPtr Load(const std::string &key, const std::string &file, const std::string &root, size_t maxFileSize, bool precompressed);
+    static bool IsModified(const Entry &entry, bool precompressed);
+    static size_t GetCost(const Entry &entry);
+    static uint64_t Now();
+    void Insert(const std::string &key, const EntryPtr &entry, uint64_t now);
+    void Evict(size_t limit);
+
+private:
+    struct Item
+    {
+        EntryPtr entry;
+        uint64_t validated;
+        std::list<std::string>::iterator position;
+    };
+
+    std::unordered_map<std::string, Item> m_items;
+    std::list<std::string> m_lru;
+    size_t m_size = 0;
+    mutable Mutex m_mutex;
+};
+
+}
+
+#endif // WEBCPP_FILECACHE_H
@@ -77,8 +77,29 @@ private:
     PROPERTY(bool, WsProcessDefault, true)
     PROPERTY(int, WsServerPort, 8081)
     PROPERTY(Http::Protocol, WsProtocol, Http::Protocol::WS)
+    PROPERTY(size_t, WsMaxMessageSize, 16_Mb)
+    PROPERTY(int, WsPingInterval, 30000)
+    PROPERTY(int, WsPongTimeout, 10000)
+    PROPERTY(int, WsHandshakeTimeout, 10000)
+    PROPERTY(int, WsSendDelay, 0)
+    PROPERTY(size_t, WsSendBatchSize, 64_Kb)
+    PROPERTY(int, WsWorkerThreads, 1)
+    PROPERTY(bool, WsCompressionEnabled, true)
+    PROPERTY(int, WsCompressionWindowBits, 15)
+    PROPERTY(bool, WsContextTakeover, true)
+    PROPERTY(size_t, WsCompressionMinSize, 256)
+    PROPERTY(size_t, WsCompressionMemoryLimit, 64_Mb)
     PROPERTY(size_t, MaxBodySize, 2_Mb)
     PROPERTY(size_t, MaxBodyFileSize, 20_Mb)
+    PROPERTY(bool, FileCacheEnabled, true)
+    PROPERTY(size_t, FileCacheSize, 32_Mb)
+    PROPERTY(size_t, FileCacheMaxFileSize, 512_Kb)
+    PROPERTY(int, FileCacheRevalidate, 1000)
+    PROPERTY(bool, Precompressed, true)
+    PROPERTY(bool, CompressionEnabled, true)
+    PROPERTY(int, CompressionLevel, 6)
+    PROPERTY(size_t, CompressionMinSize, 1_Kb)
+    PROPERTY(std::string, CompressionTypes, "text/html,text/css,text/plain,text/xml,text/csv,text/javascript,application/javascript,application/json,application/xml,image/svg+xml")
 
 };
 
@@ -140,12 +140,15 @@ public:
 
     bool Parse(const ByteArray &data, size_t start = 0);
     bool ParseHeader(const ByteArray &data);
+    bool ParseTrailer(const ByteArray &data);
     ByteArray ToByteArray() const;
     bool IsComplete() const;
     size_t GetHeaderSize() const;
     size_t GetBodySize() const;
+    bool IsBodySizeValid() const;
     size_t GetRequestSize() const;
     void SetChunckedSize(size_t size);
+    bool IsChunked() const;
     HeaderRole GetRole() const;
 
     void SetVersion(const std::string &version);
@@ -163,6 +166,8 @@ public:
     const std::vector<HttpHeader::Header> &GetHeaders() const;
     void SetHeader(HeaderType type, const std::string &value);
     void SetHeader(const std::string &name, const std::string &value);
+    void RemoveHeader(HeaderType type);
+    void RemoveHeader(const std::string &name);
     void Clear();
 
     static HttpHeader::HeaderType String2HeaderType(const std::string &str);
@@ -171,17 +176,20 @@ public:
     std::string ToString() const;
 
 protected:
-    bool ParseHeaders(const ByteArray &data, const StringUtil::Ranges &ranges);
+    bool ParseHeaders(const ByteArray &data, size_t start, size_t end);
+    void SetHeader(const char *name, size_t nameLength, const char *value, size_t valueLength);
 
 private:
     HeaderRole m_role;
     bool m_complete = false;
     std::vector<Header> m_headers = {};
+    std::vector<Header> m_spare = {};
     std::string m_version = "HTTP/1.1";
     size_t m_headerSize = 0;
     std::string m_remoteAddress;
     int m_remotePort = (-1);
     size_t m_chunkedSize = 0;
+    bool m_lengthConflict = false;
 };
 
 }
@@ -46,6 +46,10 @@
 namespace WebCpp
 {
 
+#ifdef WITH_WEBSOCKET
+class WebSocketServer;
+#endif
+
 class HttpServer: public IErrorable, public IRunnable
 {
 public:
@@ -63,12 +67,17 @@ public:
 
     HttpServer& OnGet(const std::string &path, const RouteHttp::RouteFunc &f, bool needAuth = false);
     HttpServer& OnPost(const std::string &path, const RouteHttp::RouteFunc &f, bool needAuth = false);
+    HttpServer& OnPostStream(const std::string &path, const RouteHttp::BodyFunc &body, const RouteHttp::RouteFunc &f, bool needAuth = false);
     void SetPreRouteFunc(const RouteHttp::RouteFunc &callback);
     void SetPostRouteFunc(const RouteHttp::RouteFunc &callback);
     using AuthHandler = std::function<bool(const Request &request, IAuth *authMethod)>;
     void SetAuthHandler(const AuthHandler &f);
 
     bool SendResponse(Response &response);
+    std::shared_ptr<ICommunicationServer> GetCommunicationServer() const;
+#ifdef WITH_WEBSOCKET
+    void SetWebSocketServer(WebSocketServer *server);
+#endif
 
     std::string ToString() const;
 
@@ -76,6 +85,9 @@ protected:
     void OnConnected(int connID, const std::string& remote);
     void OnDataReady(int connID, ByteArray &data);
     void OnClosed(int connID);
+#ifdef WITH_WEBSOCKET
+    void OnWriteReady(int connID);
+#endif
 
     bool StartRequestThread();
     bool StopRequestThread();
@@ -87,15 +99,32 @@ protected:
     void AppendData(int connID, const ByteArray &data);
     bool IsQueueEmpty();
     bool CheckDataFullness();
-    std::unique_ptr<Request> GetNextRequest();
+    RequestPtr GetNextRequest(ResponsePtr &response);
     void RemoveFromQueue(int connID);
-
-    void ProcessRequest(Request &request);
+    bool OnHeaderComplete(Session &session);
+    void OnBodyRejected(int connID, uint16_t code, const std::string &reason);
+    bool CheckRequest(Session &session);
+    bool Authenticate(Request &request);
+    void Reject(int connID, uint16_t code);
+    void Reject(Response &response);
+    void CloseRejected();
+
+    void ProcessRequest(Request &request, ResponsePtr response);
+    bool IsNotModified(const Request &request, const Response &response) const;
+    void ProcessRange(const Request &request, Response &response) const;
     void ProcessKeepAlive(int connID);    
+#ifdef WITH_WEBSOCKET
+    bool Upgrade(Request &request);
+    bool IsUpgraded(int connID) const;
+    bool ReleaseUpgraded(int connID);
+#endif
 
 private:
     std::shared_ptr<ICommunicationServer> m_server = nullptr;
     Http::Protocol m_protocol = Http::Protocol::Undefined;
+    bool m_clockStarted = false;
+    // declared before the sessions so the responses they keep are released before the pool is destroyed
+    ResponsePool m_responsePool;
     SessionManager m_sessions;
     ThreadWorker m_requestThread;
     Mutex m_queueMutex;
@@ -106,6 +135,11 @@ private:
     RouteHttp::RouteFunc m_preRoute = nullptr;
     RouteHttp::RouteFunc m_postRoute = nullptr;
     AuthHandler m_authHandler = nullptr;
+    std::vector<int> m_rejected;
+#ifdef WITH_WEBSOCKET
+    WebSocketServer *m_webSocket = nullptr;
+    std::vector<bool> m_upgraded;
+#endif
 };
 
 }
@@ -0,0 +1,84 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef WEBCPP_MULTIPART_PARSER_H
+#define WEBCPP_MULTIPART_PARSER_H
+
+#include <functional>
+#include <string>
+#include "common_webcpp.h"
+#include "IErrorable.h"
+
+
+namespace WebCpp
+{
+
+/**
+ * @brief The MultipartParser class is an incremental multipart/form-data parser.
+ * The data can be passed in pieces of any size as they arrive, only a small
+ * tail that could be a part of the boundary is kept between the calls
+ */
+class MultipartParser: public IErrorable
+{
+public:
+    using PartFunc = std::function<bool(const ByteArray &header)>;
+    using DataFunc = std::function<bool(const uint8_t *data, size_t size)>;
+    using PartEndFunc = std::function<bool()>;
+
+    MultipartParser(const std::string &boundary);
+    MultipartParser(const MultipartParser &other) = delete;
+    MultipartParser& operator=(const MultipartParser &other) = delete;
+
+    void SetPartCallback(const PartFunc &callback);
+    void SetDataCallback(const DataFunc &callback);
+    void SetPartEndCallback(const PartEndFunc &callback);
+
+    bool Parse(const uint8_t *data, size_t size);
+    bool IsComplete() const;
+
+protected:
+    enum class State
+    {
+        Preamble,
+        Boundary,
+        Header,
+        Data,
+        Epilogue,
+    };
+
+    bool Process();
+    bool ProcessData(bool preamble);
+
+private:
+    ByteArray m_delimiter;
+    ByteArray m_buffer;
+    State m_state = State::Preamble;
+    PartFunc m_partCallback = nullptr;
+    DataFunc m_dataCallback = nullptr;
+    PartEndFunc m_partEndCallback = nullptr;
+};
+
+}
+
+#endif // WEBCPP_MULTIPART_PARSER_H
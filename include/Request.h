@@ -36,6 +36,7 @@
 #include "IHttp.h"
 #include "IErrorable.h"
 #include "IAuth.h"
+#include "ObjectPool.h"
 
 
 namespace WebCpp
@@ -52,7 +53,12 @@ public:
     Request(Request&& other) = default;
     Request& operator=(Request&& other) = default;
 
-    bool Parse(const ByteArray &data);
+    bool Parse(const ByteArray &data, bool body = true);
+    bool ParseBody(const ByteArray &data);
+    bool BeginBody();
+    bool AppendBody(const uint8_t *data, size_t size);
+    bool EndBody();
+    bool IsBodyStreamed() const;
     int GetConnectionID() const;
     void SetConnectionID(int connID);
     const HttpConfig& GetConfig() const;
@@ -79,6 +85,10 @@ public:
     void SetSession(Session *session);
     Session* GetSession() const;
     bool CheckAuth();
+    bool IsAuthenticated() const;
+    void SetAuthenticated(bool authenticated);
+    bool IsPreRouted() const;
+    void SetPreRouted(bool preRouted);
     std::string ToString() const;
 
 protected:
@@ -98,8 +108,15 @@ private:
     RequestBody m_requestBody;
     std::string m_remote;
     Session *m_session = nullptr;
+    const HttpConfig *m_config = &HttpConfig::Instance();
+    bool m_bodyStreamed = false;
+    bool m_authenticated = false;
+    bool m_preRouted = false;
 };
 
+using RequestPool = ObjectPool<Request>;
+using RequestPtr = RequestPool::Ptr;
+
 }
 
 #endif // WEBCPP_REQUEST_H
@@ -29,12 +29,16 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <memory>
 #include "IErrorable.h"
 
 
 namespace WebCpp
 {
 
+class MultipartParser;
+class File;
+
 class RequestBody: public IErrorable
 {
 public:
@@ -56,6 +60,11 @@ public:
     RequestBody& operator=(RequestBody&& other);
 
     bool Parse(const ByteArray &data, size_t offset, const ByteArray &contentType, bool useTempFile);
+    bool BeginStream(const ByteArray &contentType, bool useTempFile);
+    bool AppendStream(const uint8_t *data, size_t size);
+    bool EndStream();
+    bool IsStreaming() const;
+    static bool IsStreamable(const ByteArray &contentType);
 
     ContentType GetContentType() const;
     void SetContentType(ContentType type);
@@ -66,8 +75,11 @@ public:
         std::string contentType;
         std::string fileName;
         ByteArray data;
+        std::shared_ptr<File> file;
 
         std::string GetDataString() const;
+        size_t GetSize() const;
+        bool Save(const std::string &path) const;
         static ContentValue defaultValue;
     };
 
@@ -75,6 +87,10 @@ public:
     const ContentValue& GetValue(const std::string &name) const;
     void SetValue(const std::string &name, const ByteArray &data, const std::string &contentType = "");
     void SetValue(const std::string &name, const std::string &fileName, const std::string &contentType = "");
+    // uploads are unnamed files now, there is no file to open in this folder by name,
+    // it returns the spool folder of the calling thread, not a folder shared by the process,
+    // and it's empty until a file was received by this thread
+    WEBCPP_DEPRECATED("returns the per-thread spool folder now, use ContentValue::Save() or ContentValue::file to access the uploaded file")
     std::string GetTempFolder() const;
     ByteArray ToByteArray();
     std::string BuildContentType() const;
@@ -84,9 +100,14 @@ protected:
     std::map<std::string, std::string> ParseHeaders(const ByteArray &header) const;
     std::map<std::string, std::string> ParseFields(const ByteArray &header) const;
     std::string GetHeader(const std::string &name, const std::map<std::string, std::string> &map) const;
-    ContentType ParseContentType(const ByteArray &contentType) const;
+    static ContentType ParseContentType(const ByteArray &contentType);
+    static std::string GetSpoolFolder(bool create);
 
     bool ParseFormData(const ByteArray &data, size_t offset, const ByteArray &contentType, bool useTempFile);
+    void BindParser();
+    bool OnPartHeader(const ByteArray &header);
+    bool OnPartData(const uint8_t *data, size_t size);
+    bool OnPartEnd();
     bool ParseUrlEncoded(const ByteArray &data, size_t offset, const ByteArray &contentType);
     bool ParseText(const ByteArray &data, size_t offset, const ByteArray &contentType);
 
@@ -98,8 +119,10 @@ protected:
 private:
     std::vector<ContentValue> m_values;
     ContentType m_contentType = ContentType::Undefined;
-    std::string m_tempFolder;
     std::string m_boundary;
+    bool m_useTempFile = false;
+    std::unique_ptr<MultipartParser> m_parser;
+    std::shared_ptr<File> m_file;
 };
 
 }
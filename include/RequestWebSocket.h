@@ -4,6 +4,7 @@
 #include "common_webcpp.h"
 #include "common_ws.h"
 #include "ICommunicationClient.h"
+#include "WebSocketDeflate.h"
 
 
 namespace WebCpp
@@ -13,21 +14,46 @@ class RequestWebSocket
 {
 public:
     RequestWebSocket();
-    bool Parse(const ByteArray &data);
+    bool Parse(ByteArray &data, size_t offset = 0, size_t minChunk = SIZE_MAX);
+    bool ParseHeader(const ByteArray &data, size_t offset = 0);
+    bool ParseNext(ByteArray &data, size_t offset, size_t minChunk = SIZE_MAX);
+    bool IsComplete() const;
+    bool IsFirst() const;
+    uint64_t GetLength() const;
     bool IsFinal() const;
+    bool IsCompressed() const;
     MessageType GetType() const;
     void SetType(MessageType type);
     size_t GetSize() const;
+    size_t GetPayloadOffset() const;
+    size_t GetPayloadSize() const;
     const ByteArray& GetData() const;
     void SetData(const ByteArray& data);
+#ifdef WITH_ZLIB
+    void SetCompression(WebSocketDeflate *deflate, size_t minSize);
+#endif
 
     bool Send(ICommunicationClient *communication) const;
 
 private:
+    void UnmaskPayload(ByteArray &data);
+
     ByteArray m_data;
     bool m_final = false;
+    bool m_compressed = false;
     size_t m_size = 0;
+    size_t m_headerSize = 0;
+    size_t m_payloadOffset = 0;
+    size_t m_payloadSize = 0;
+    uint64_t m_length = 0;
+    uint64_t m_received = 0;
+    bool m_masked = false;
+    WebSocketHeaderMask m_mask = {};
     MessageType m_messageType = MessageType::Undefined;
+#ifdef WITH_ZLIB
+    WebSocketDeflate *m_deflate = nullptr;
+    size_t m_compressionMinSize = 0;
+#endif
 };
 
 }
@@ -27,11 +27,15 @@
 
 #include <string>
 #include <map>
+#include <vector>
+#include <functional>
 #include "ICommunicationServer.h"
 #include "common_webcpp.h"
 #include "HttpConfig.h"
 #include "HttpHeader.h"
 #include "IErrorable.h"
+#include "FileCache.h"
+#include "ObjectPool.h"
 
 
 namespace WebCpp
@@ -47,6 +51,31 @@ public:
 
     };
 
+    class Writer
+    {
+    public:
+        Writer(ICommunicationServer *communication, int connID);
+        Writer(const Writer& other) = delete;
+        Writer& operator=(const Writer& other) = delete;
+
+        bool Write(const uint8_t *data, size_t size);
+        bool Write(const ByteArray &data);
+        bool Write(const std::string &data);
+        size_t GetWritten() const;
+        bool IsError() const;
+
+    protected:
+        friend class Response;
+        bool Finish();
+
+    private:
+        ICommunicationServer *m_communication;
+        int m_connID;
+        size_t m_written = 0;
+        bool m_error = false;
+    };
+    using StreamFunc = std::function<bool(Writer &writer)>;
+
     Response(int connID, const HttpConfig& config);
     Response(const Response& other) = delete;
     Response& operator=(const Response& other) = delete;
@@ -59,7 +88,11 @@ public:
     void Write(const ByteArray &data, size_t start = 0);
     void Write(const std::string &data);
     bool AddFile(const std::string &file, const std::string &charset = "utf-8");
+    bool SetRange(const std::string &range);
+    bool Compress(const std::string &acceptEncoding, bool chunked = true);
+    void SetStreamFunction(const StreamFunc &func);
     bool NotFound();
+    bool NotModified();
     bool Redirect(const std::string &url);
     bool Unauthorized();
     bool NotAuthenticated();
@@ -78,6 +111,9 @@ public:
 
     void SetSession(Session *session);
     Session* GetSession() const;
+    int GetConnectionID() const;
+    void SetConnectionID(int connID);
+    void Clear();
 
     static std::string HeaderType2String(Response::HeaderType headerType);
     static Response::HeaderType String2HeaderType(const std::string &str);
@@ -95,12 +131,25 @@ protected:
         Brotli,
     };
 
+    struct Range
+    {
+        size_t start;
+        size_t length;
+        ByteArray header;
+    };
+
     void InitDefault();
     ByteArray BuildStatusLine() const;
     ByteArray BuildHeaders() const;    
     bool ParseStatusLine(const ByteArray &data, size_t &pos);
     bool DecodeBody(EncodingType type, const ByteArray &data, size_t pos);
+    bool SendFileRange(ICommunicationServer *communication, int fd, size_t offset, size_t length);
+    bool SendFileEncoded(ICommunicationServer *communication, int fd);
+    bool IsCompressible(const std::string &mimeType) const;
     static EncodingType String2EncodingType(const std::string &str);
+    static std::string EncodingType2String(EncodingType type);
+    static EncodingType NegotiateEncoding(const std::string &acceptEncoding, const std::vector<EncodingType> &available);
+    static bool String2Size(const std::string &str, size_t &value);
 
 private:
     int m_connID;
@@ -112,10 +161,19 @@ private:
     std::string m_responsePhrase = "";
     std::string m_mimeType = "";   
     std::string  m_file;
+    FileCache::EntryPtr m_fileEntry = nullptr;
+    std::vector<Range> m_ranges;
+    FileCache::EncodedPtr m_encoded = nullptr;
+    EncodingType m_streamEncoding = EncodingType::Undefined;
+    StreamFunc m_streamFunc = nullptr;
+    ByteArray m_rangesTail;
     bool m_shouldSend = true;
     Session *m_session = nullptr;
 };
 
+using ResponsePool = ObjectPool<Response>;
+using ResponsePtr = ResponsePool::Ptr;
+
 }
 
 #endif // WEBCPP_RESPONSE_H
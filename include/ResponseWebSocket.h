@@ -30,6 +30,7 @@
 #include "common_webcpp.h"
 #include "ICommunicationServer.h"
 #include "common_ws.h"
+#include "WebSocketDeflate.h"
 
 namespace WebCpp
 {
@@ -45,6 +46,7 @@ public:
     ResponseWebSocket& operator=(ResponseWebSocket&& other) = delete;
 
     bool IsEmpty() const;
+    int GetConnectionID() const;
     void WriteText(const ByteArray &data);
     void WriteText(const std::string &data);
     void WriteBinary(const ByteArray &data);
@@ -55,13 +57,25 @@ public:
 
     const ByteArray& GetData() const;
 
+    ByteArray ToByteArray() const;
     bool Send(ICommunicationServer *communication) const;
-    bool Parse(const ByteArray &data);
+    bool Parse(const ByteArray &data, size_t offset = 0);
+    size_t GetSize() const;
+    bool IsCompressed() const;
+#ifdef WITH_ZLIB
+    void SetCompression(WebSocketDeflate *deflate, size_t minSize);
+#endif
 
 private:
     int m_connID = (-1);
     ByteArray m_data;
     MessageType m_messageType = MessageType::Undefined;
+    size_t m_size = 0;
+    bool m_compressed = false;
+#ifdef WITH_ZLIB
+    WebSocketDeflate *m_deflate = nullptr;
+    size_t m_compressionMinSize = 0;
+#endif
 };
 
 }
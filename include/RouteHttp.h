@@ -37,14 +37,18 @@ class RouteHttp: public Route
 {
 public:
     using RouteFunc = std::function<bool(const Request&request, Response &response)>;
+    using BodyFunc = std::function<bool(const Request&request, const uint8_t *data, size_t size)>;
 
     RouteHttp(const std::string &path, Http::Method method, bool useAuth = false);
 
     bool SetFunction(const RouteFunc& f);
     const RouteFunc& GetFunction() const;
+    bool SetBodyFunction(const BodyFunc& f);
+    const BodyFunc& GetBodyFunction() const;
 
 private:
     RouteFunc m_func;
+    BodyFunc m_bodyFunc;
 };
 
 }
@@ -41,6 +41,8 @@ class RouteWebSocket: public Route
 public:    
     using RouteFuncRequest = std::function<bool(const Request&request, Response &response)>;
     using RouteFuncMessage = std::function<bool(const Request& request, ResponseWebSocket &response, const ByteArray& data)>;
+    using RouteFuncChunk = std::function<bool(const Request& request, ResponseWebSocket &response, const ByteArray& chunk, bool last)>;
+    using RouteFuncView = std::function<bool(const Request& request, ResponseWebSocket &response, const uint8_t *data, size_t size)>;
 
     RouteWebSocket(const std::string &path);
 
@@ -50,9 +52,21 @@ public:
     bool SetFunctionMessage(const RouteFuncMessage& f);
     const RouteFuncMessage& GetFunctionMessage() const;
 
+    bool SetFunctionChunk(const RouteFuncChunk& f);
+    const RouteFuncChunk& GetFunctionChunk() const;
+
+    bool SetFunctionView(const RouteFuncView& f);
+    const RouteFuncView& GetFunctionView() const;
+
+    void SetMaxMessageSize(size_t size);
+    size_t GetMaxMessageSize() const;
+
 private:
     RouteFuncRequest m_funcRequest;
     RouteFuncMessage m_funcMessage;
+    RouteFuncChunk m_funcChunk;
+    RouteFuncView m_funcView;
+    size_t m_maxMessageSize = 0;
 };
 
 }
@@ -1,23 +1,38 @@
 #ifndef SESSION_H
 #define SESSION_H
 
+#include <functional>
 #include "common_webcpp.h"
 #include "AuthProvider.h"
+#include "ChunkedDecoder.h"
+#include "Request.h"
+#include "Response.h"
 
 
 namespace WebCpp
 {
-class Request;
+
 struct Session
 {
 public:
-    Session(int connID, const std::string &remote);
+    using BodyFunc = std::function<bool(const uint8_t *data, size_t size)>;
+
+    Session(const std::string &remote);
+    void Reset(int connID, RequestPtr request);
 
     ByteArray data;
-    std::unique_ptr<Request> request;
+    RequestPtr request;
     bool readyForDispatch;
     std::string remote;
     AuthProvider authProvider;
+    bool headerChecked = false;
+    bool closing = false;
+    BodyFunc bodyFunc = nullptr;
+    size_t bodyReceived = 0;
+    size_t bodyLimit = SIZE_MAX;
+    std::unique_ptr<ChunkedDecoder> chunkedDecoder;
+    // the response the pre-route handler has already filled in while checking the header
+    ResponsePtr response;
 };
 
 }
@@ -3,6 +3,7 @@
 
 #include <map>
 #include <memory>
+#include <functional>
 #include "common_webcpp.h"
 #include "IErrorable.h"
 #include "Request.h"
@@ -16,17 +17,30 @@ namespace WebCpp
 class SessionManager : public IErrorable
 {
 public:
+    using HeaderCallback = std::function<bool(Session &session)>;
+    using RejectCallback = std::function<void(int connID, uint16_t code, const std::string &reason)>;
+
     SessionManager();
+    void SetHeaderCallback(const HeaderCallback &callback);
+    void SetRejectCallback(const RejectCallback &callback);
+    void SetConfig(const HttpConfig &config);
     bool AddNewSession(int connID, const std::string &remote);
     bool AppendData(int connID, const ByteArray &data);
     bool Process();
-    std::unique_ptr<Request> GetReadyRequest();
+    RequestPtr GetReadyRequest();
+    RequestPool& GetRequestPool();
     bool RemoveSession(int connID);
+    bool DetachSession(int connID, ByteArray &data);
     bool IsEmpty() const;
+protected:
+    RequestPtr NewRequest();
 private:
-
-
+    // declared first so the pooled requests are released before the pool itself is destroyed
+    RequestPool m_requestPool;
     std::map<int, Session> m_sesions;
+    HeaderCallback m_headerCallback = nullptr;
+    RejectCallback m_rejectCallback = nullptr;
+    const HttpConfig *m_config = nullptr;
 };
 
 }
@@ -54,6 +54,7 @@ protected:
     void OnDataReady(const ByteArray &data);
     void OnClosed();
     bool InitConnection(const Url &url);
+    bool InitCompression(const std::string &extension);
     void SetState(State state);
 
 private:
@@ -68,6 +69,9 @@ private:
     State m_state = State::Undefined;
     std::string m_key;
     ByteArray m_data;
+#ifdef WITH_ZLIB
+    std::unique_ptr<WebSocketDeflate> m_deflate;
+#endif
 };
 
 }
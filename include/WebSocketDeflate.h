@@ -0,0 +1,76 @@
+#ifdef WITH_ZLIB
+
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef WEBCPP_WEBSOCKETDEFLATE_H
+#define WEBCPP_WEBSOCKETDEFLATE_H
+
+#include <string>
+#include "common_webcpp.h"
+#include "Data.h"
+
+
+namespace WebCpp
+{
+
+// permessage-deflate extension, RFC 7692
+class WebSocketDeflate
+{
+public:
+    struct Params
+    {
+        bool serverNoContextTakeover = false;
+        bool clientNoContextTakeover = false;
+        int serverMaxWindowBits = 15;
+        int clientMaxWindowBits = 15;
+    };
+
+    WebSocketDeflate(const Params &params, bool server, int level = -1);
+    WebSocketDeflate(const WebSocketDeflate& other) = delete;
+    WebSocketDeflate& operator=(const WebSocketDeflate& other) = delete;
+
+    bool IsValid() const;
+    bool Compress(const uint8_t *data, size_t size, ByteArray &out);
+    bool Decompress(const uint8_t *data, size_t size, ByteArray &out, size_t limit = SIZE_MAX, bool last = true);
+    size_t GetMemoryUsage() const;
+
+    static bool Negotiate(const std::string &offers, const Params &config, Params &params, std::string &response);
+    static bool ParseResponse(const std::string &extension, Params &params);
+    static std::string GetOffer();
+    static size_t EstimateMemory(const Params &params);
+
+private:
+    Data::Deflater m_deflater;
+    Data::Inflater m_inflater;
+    bool m_resetDeflater;
+    bool m_resetInflater;
+    size_t m_memory;
+};
+
+}
+
+#endif // WEBCPP_WEBSOCKETDEFLATE_H
+
+#endif
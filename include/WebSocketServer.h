@@ -28,7 +28,13 @@
 #define WEBCPP_WEBSOCKETSERVER_H
 
 #include <memory>
+#include <atomic>
+#include <vector>
 #include <deque>
+#include <queue>
+#include <functional>
+#include <map>
+#include <set>
 #include "HttpConfig.h"
 #include "RouteHttp.h"
 #include "RouteWebSocket.h"
@@ -38,6 +44,7 @@
 #include "ICommunicationServer.h"
 #include "RequestWebSocket.h"
 #include "ResponseWebSocket.h"
+#include "WebSocketDeflate.h"
 #include "ThreadWorker.h"
 #include "Mutex.h"
 #include "Signal.h"
@@ -46,8 +53,11 @@
 namespace WebCpp
 {
 
+class HttpServer;
+
 class WebSocketServer: public IErrorable, public IRunnable
 {
+    friend class HttpServer;
 public:
     WebSocketServer();
     virtual ~WebSocketServer();
@@ -58,72 +68,234 @@ public:
 
     bool Init() override;
     bool Init(WebCpp::HttpConfig config);
+    bool Init(HttpServer &server);
     bool Run() override;
     bool Close(bool wait = true) override;
     bool WaitFor() override;
 
     void OnRequest(const std::string &path, const RouteHttp::RouteFunc &func);
     void OnMessage(const std::string &path, const std::function<bool(const Request& request, ResponseWebSocket &response, const ByteArray &data)>& func);
+    void OnMessageChunk(const std::string &path, const std::function<bool(const Request& request, ResponseWebSocket &response, const ByteArray &chunk, bool last)>& func);
+    void OnMessageView(const std::string &path, const std::function<bool(const Request& request, ResponseWebSocket &response, const uint8_t *data, size_t size)>& func);
+    void SetMaxMessageSize(const std::string &path, size_t size);
 
     bool SendResponse(const ResponseWebSocket &response);
 
+    bool Subscribe(int connID, const std::string &topic);
+    bool Unsubscribe(int connID, const std::string &topic);
+    size_t Broadcast(const std::string &topic, const ByteArray &data, MessageType type = MessageType::Text);
+    size_t Broadcast(const std::string &topic, const std::string &data, MessageType type = MessageType::Text);
+
+    size_t GetReapedCount() const;
+
     Http::Protocol GetProtocol() const;
     std::string ToString() const;
 
 protected:
+    using Frame = std::shared_ptr<const ByteArray>;
+
+    struct OutputQueue
+    {
+        bool open = false;
+        bool dirty = false;
+        bool writing = false;
+        // the socket doesn't take more now, the output waits until it's writable
+        bool blocked = false;
+        // the connection is closed by the writer after the queued frames
+        bool closing = false;
+        // the connection the output is opened for, the slot could be reused while a handler still runs
+        const void *owner = nullptr;
+        // changes when the slot is opened or closed so the writer knows the connection is gone
+        uint64_t generation = 0;
+        std::deque<Frame> frames;
+        // the part of the first frame that is written already
+        size_t offset = 0;
+        size_t size = 0;
+        uint64_t since = 0;
+        std::set<std::string> topics;
+    };
+
     struct RequestData
     {
         RequestData(int connID, const std::string &remote)
         {
             this->connID= connID;
             readyForDispatch = false;
+            dispatching = false;
+            removed = false;
             handshake = false;
+            dirty = false;
+            offset = 0;
+            framePending = false;
+            frameChecked = false;
+            messageActive = false;
+            messageLength = 0;
+            messageType = MessageType::Undefined;
+            messageCompressed = false;
+            messageSize = 0;
+            maxMessageSize = 0;
+            streaming = false;
+            view = false;
+            closing = false;
+            closeCode = CloseCode::Normal;
+            lastActivity = 0;
+            pingTime = 0;
+            pingPending = false;
+            serial = 0;
             request.SetConnectionID(connID);
             request.GetHeader().SetRemote(remote);
         }
 
         int connID;
         Request request;
+        // the received data waits here while the connection is dispatched
+        ByteArray input;
         ByteArray data;
+        size_t offset;
         std::vector<RequestWebSocket> requestList;
         bool handshake;
         bool readyForDispatch;
+        // the entry is owned by a worker, it's kept alive until the worker is done even if the connection is closed
+        bool dispatching;
+        bool removed;
+        bool dirty;
+        // the frame which payload is not received completely yet
+        RequestWebSocket frame;
+        bool framePending;
+        // the header of the next frame is already checked, its payload isn't received yet
+        bool frameChecked;
+        // the fragmented message state as it's parsed
+        bool messageActive;
+        uint64_t messageLength;
+        // the message state as it's dispatched
+        MessageType messageType;
+        bool messageCompressed;
+        size_t messageSize;
+        ByteArray message;
+        ByteArray payload;
+        size_t maxMessageSize;
+        bool streaming;
+        bool view;
+        bool closing;
+        CloseCode closeCode;
+        uint64_t lastActivity;
+        uint64_t pingTime;
+        bool pingPending;
+        // tells the connection from the previous one in the same slot
+        uint64_t serial;
+#ifdef WITH_ZLIB
+        std::unique_ptr<WebSocketDeflate> deflate;
+#endif
+    };
+
+    // the keep-alive check of a connection, the earliest one is on the top
+    struct AliveTimer
+    {
+        uint64_t deadline;
+        int connID;
+        uint64_t serial;
+        bool operator>(const AliveTimer &other) const { return deadline > other.deadline; }
+    };
+
+    struct Worker
+    {
+        ThreadWorker thread;
+        Mutex mutex;
+        Signal signal;
+        std::deque<RequestData*> queue;
     };
 
     void OnConnected(int connID, const std::string& remote);
     void OnDataReady(int connID, ByteArray &data);
     void OnClosed(int connID);
+    void OnWriteReady(int connID);
 
+    bool Start();
+    void Detach();
     bool StartRequestThread();
     bool StopRequestThread();
     void* RequestThread(bool &running);
+    bool StartWorkers();
+    void StopWorkers();
+    void* WorkerThread(bool &running, Worker *worker);
+    void Dispatch(RequestData &requestData);
 
     void SendSignal();
-    void WaitForSignal();
+    void WaitForSignal(uint32_t timeout = 0);
     void InitConnection(int connID, const std::string &remote);
-    void PutToQueue(int connID, ByteArray &data);
+    void PutToQueue(int connID, const ByteArray &data);
+    bool CanUpgrade(Request &request);
+    void Upgrade(Request &request, ByteArray &data);
+    RequestData* GetConnection(int connID);
+    void SetDirty(RequestData &requestData);
 
     bool IsQueueEmpty();
     bool CheckData();
     void ProcessRequests();
     void RemoveFromQueue(int connID);
-    bool ProcessRequest(Request &request);
+    bool ProcessRequest(RequestData &requestData);
+    bool SendHandshake(RequestData &requestData);
+    void TakeInput(RequestData &requestData);
     bool CheckWsHeader(RequestData& requestData);
     bool CheckWsFrame(RequestData &requestData);
-    bool ProcessWsRequest(Request &request, const RequestWebSocket &wsRequest);
+    bool CheckWsMessage(RequestData &requestData, const RequestWebSocket &frame);
+    void SetClosing(RequestData &requestData, CloseCode code);
+    void InitMessageLimits(RequestData &requestData);
+    bool DispatchFrame(RequestData &requestData, const RequestWebSocket &frame);
+    bool ReadPayload(RequestData &requestData, const uint8_t *data, size_t size, ByteArray &out, bool last);
+    void CloseConnection(int connID, CloseCode code);
+    void CompactBuffer(RequestData &requestData);
+    void OpenOutput(int connID, const RequestData *owner);
+    void CloseOutput(int connID);
+    bool QueueFrame(int connID, const Frame &frame);
+    bool QueueResponse(const ResponseWebSocket &response, const RequestData *owner = nullptr);
+    void FlushOutput();
+    void WriteOutput(int connID);
+    size_t WriteFrames(int connID, const std::deque<Frame> &frames, size_t offset);
+    void CheckAlive();
+    uint64_t GetAliveDeadline(const RequestData &requestData) const;
+    static uint64_t Now();
+    bool ProcessWsRequest(RequestData &requestData, MessageType type, const ByteArray &data);
+    bool ProcessWsRequest(RequestData &requestData, MessageType type, const uint8_t *data, size_t size, const ByteArray *message = nullptr);
+    bool ProcessWsChunk(RequestData &requestData, const ByteArray &chunk, bool last);
+#ifdef WITH_ZLIB
+    bool NegotiateCompression(RequestData &requestData, std::string &extension);
+#endif
     RouteWebSocket* GetRoute(const std::string &path);
 
 private:
     std::shared_ptr<ICommunicationServer> m_server = nullptr;
     Http::Protocol m_protocol = Http::Protocol::Undefined;
+    bool m_attached = false;
+    bool m_clockStarted = false;
+    HttpServer *m_httpServer = nullptr;
     ThreadWorker m_requestThread;
     Mutex m_queueMutex;
     Mutex m_signalMutex;
-    Mutex m_requestMutex;
     Signal m_signalCondition;
-    std::deque<RequestData> m_requestQueue;
+    bool m_signalPending = false;
+    std::vector<std::unique_ptr<RequestData>> m_connections;
+    std::vector<std::unique_ptr<RequestData>> m_retired;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    size_t m_connectionCount = 0;
+    std::vector<int> m_dirty;
+    std::vector<int> m_ready;
     HttpConfig &m_config;
     std::vector<RouteWebSocket> m_routes;
+    Mutex m_outputMutex;
+    std::vector<OutputQueue> m_outputs;
+    std::vector<int> m_outputDirty;
+    std::map<std::string, std::set<int>> m_topics;
+    Frame m_pingFrame;
+    std::string m_handshakeHeader;
+    uint64_t m_nextCheck = 0;
+    bool m_keepAlive = false;
+    uint64_t m_serial = 0;
+    std::priority_queue<AliveTimer, std::vector<AliveTimer>, std::greater<AliveTimer>> m_aliveTimers;
+    std::atomic<size_t> m_reapedCount;
+#ifdef WITH_ZLIB
+    size_t m_deflateMemory = 0;
+#endif
 };
 
 }
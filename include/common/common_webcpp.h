@@ -37,6 +37,16 @@
 #define WEBCPP_NAME "WebCpp"
 #define WEBCPP_CANONICAL_NAME WEBCPP_NAME " " WEBCPP_VERSION
 
+#if __cplusplus >= 201402L
+#define WEBCPP_DEPRECATED(msg) [[deprecated(msg)]]
+#elif defined(__GNUC__) || defined(__clang__)
+#define WEBCPP_DEPRECATED(msg) __attribute__((deprecated(msg)))
+#elif defined(_MSC_VER)
+#define WEBCPP_DEPRECATED(msg) __declspec(deprecated(msg))
+#else
+#define WEBCPP_DEPRECATED(msg)
+#endif
+
 using ByteArray = std::vector<uint8_t>;
 
 struct point
@@ -83,4 +83,13 @@
         Pong = 10,
     };
 
+    enum class CloseCode
+    {
+        Normal = 1000,
+        GoingAway = 1001,
+        ProtocolError = 1002,
+        InvalidData = 1007,
+        MessageTooBig = 1009,
+    };
+
 #endif // WEBCPP_COMMON_WS_H
@@ -55,6 +55,10 @@ public:
     virtual bool CloseConnection(int connID);
     virtual bool Write(int connID, ByteArray &data);
     virtual bool Write(int connID, ByteArray &data, size_t size);
+    virtual bool WriteV(int connID, const struct iovec *iov, int count);
+    virtual size_t WriteVNoWait(int connID, const struct iovec *iov, int count);
+    virtual void PollWritable(int connID);
+    virtual bool SendFile(int connID, int fileFd, size_t offset, size_t size);
     virtual bool Init() override;
     virtual bool Connect(const std::string &host = "", int port = 0) override;
     bool Close(bool wait = true) override;
@@ -64,6 +68,7 @@ public:
     virtual bool SetNewConnectionCallback(const std::function<void(int, const std::string&)> &callback) { m_newConnectionCallback = callback; return true; };
     virtual bool SetDataReadyCallback(const std::function<void(int, ByteArray &data)> &callback) { m_dataReadyCallback = callback; return true; };
     virtual bool SetCloseConnectionCallback(const std::function<void(int)> &callback) { m_closeConnectionCallback = callback; return true; };
+    virtual bool SetWriteReadyCallback(const std::function<void(int)> &callback) { m_writeReadyCallback = callback; return true; };
 
 protected:
     virtual void CloseConnections();
@@ -77,6 +82,7 @@ protected:
     std::function<void(int, const std::string&)> m_newConnectionCallback = nullptr;
     std::function<void(int, ByteArray &data)> m_dataReadyCallback = nullptr;
     std::function<void(int)> m_closeConnectionCallback = nullptr;
+    std::function<void(int)> m_writeReadyCallback = nullptr;
 };
 
 }
@@ -0,0 +1,71 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef WEBCPP_CLOCK_CACHE_H
+#define WEBCPP_CLOCK_CACHE_H
+
+#include <atomic>
+#include <string>
+#include <ctime>
+#include "ThreadWorker.h"
+#include "Mutex.h"
+
+#define DATE_LENGTH 30
+#define DATE_SLOTS 4
+
+
+namespace WebCpp
+{
+
+class ClockCache final
+{
+public:
+    static bool Run();
+    static void Stop();
+    static bool IsRunning();
+    static std::string GetDateTime();
+    static time_t GetTime();
+
+protected:
+    static void *Task(bool &running);
+    static void Update(time_t now);
+
+private:
+    struct Slot
+    {
+        time_t time;
+        char value[DATE_LENGTH];
+    };
+
+    static Slot m_slots[DATE_SLOTS];
+    static std::atomic<unsigned int> m_current;
+    static std::atomic<bool> m_running;
+    static ThreadWorker m_task;
+    static Mutex m_mutex;
+    static int m_refCount;
+};
+
+}
+
+#endif // WEBCPP_CLOCK_CACHE_H
@@ -34,20 +34,66 @@ class Data
 public:
     static std::string Base64Encode(const unsigned char *bytes_to_encode, size_t in_len);
     static std::string Base64Encode(const std::string& str);
+    static size_t Base64Encode(const uint8_t *data, size_t size, char *out);
     static std::string Base64Decode(const std::string& str);
     static std::string Sha1(const std::string &string);
     static uint8_t *Sha1Digest(const std::string &string);
+    static void Sha1Digest(const uint8_t *data, size_t size, uint8_t *digest);
     static std::string Sha256(const std::string &string);
+    static void Mask(const uint8_t *src, uint8_t *dst, size_t size, const uint8_t *mask, size_t offset = 0);
 
 #ifdef WITH_ZLIB
-    static ByteArray Compress(const ByteArray &data);
+    class Deflater
+    {
+    public:
+        enum class Format
+        {
+            Zlib = 0,
+            Raw,
+            Gzip,
+        };
+
+        Deflater(Format format, int level = -1, int windowBits = 15, int memLevel = 8);
+        ~Deflater();
+        Deflater(const Deflater& other) = delete;
+        Deflater& operator=(const Deflater& other) = delete;
+
+        bool IsValid() const;
+        bool Process(const uint8_t *data, size_t size, ByteArray &out, bool finish);
+        bool Flush(const uint8_t *data, size_t size, ByteArray &out);
+        bool Reset();
+
+    private:
+        bool Deflate(const uint8_t *data, size_t size, ByteArray &out, int flush);
+
+        struct z_stream_s *m_stream = nullptr;
+    };
+
+    class Inflater
+    {
+    public:
+        Inflater(Deflater::Format format, int windowBits = 15);
+        ~Inflater();
+        Inflater(const Inflater& other) = delete;
+        Inflater& operator=(const Inflater& other) = delete;
+
+        bool IsValid() const;
+        bool Process(const uint8_t *data, size_t size, ByteArray &out, size_t limit = SIZE_MAX);
+        bool Reset();
+
+    private:
+        struct z_stream_s *m_stream = nullptr;
+    };
+
+    static ByteArray Compress(const ByteArray &data, int level = -1);
     static ByteArray Uncompress(const ByteArray &data);
-    static ByteArray Zip(const ByteArray &data);
+    static ByteArray Zip(const ByteArray &data, int level = -1);
     static ByteArray Unzip(const ByteArray &data);
 #endif
 
 private:
     static unsigned int pos_of_char(const unsigned char chr);
+    static void Sha1Blocks(uint32_t *state, const uint8_t *data, size_t count);
 };
 
 #endif // WEBCPP_DATA_H
@@ -27,6 +27,8 @@
 
 #include <string>
 #include <vector>
+#include <ctime>
+#include <inttypes.h>
 
 
 namespace WebCpp
@@ -48,6 +50,8 @@ public:
     static bool DeleteFolder(const std::string &path);
     static std::string GetDateTime();
     static std::string GetFileModifiedTime(const std::string &file);
+    static std::string Time2String(time_t time);
+    static bool String2Time(const std::string &str, time_t &time);
     static std::string TempFolder();
     static std::string HomeFolder();
     static std::string Root();
@@ -62,6 +66,16 @@ public:
     };
 
     static std::vector<FileInfo> GetFolder(const std::string &path);
+
+    struct FileStat
+    {
+        size_t size;
+        time_t modified;
+        uint64_t inode;
+        bool folder;
+    };
+
+    static bool GetFileStat(const std::string &path, FileStat &fileStat);
 };
 
 }
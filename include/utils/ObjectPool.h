@@ -0,0 +1,168 @@
+/*
+*
+* Copyright (c) 2021 ruslan@muhlinin.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef WEBCPP_OBJECT_POOL_H
+#define WEBCPP_OBJECT_POOL_H
+
+#include <memory>
+#include <vector>
+#include <functional>
+#include <type_traits>
+#include "Lock.h"
+
+#define DEFAULT_POOL_CAPACITY 32
+
+
+namespace WebCpp
+{
+
+/**
+ * @brief The ObjectPool class keeps released objects and hands them out again instead of
+ * allocating new ones. An object is reset with its Clear() on release so the memory already
+ * grown by its containers is reused by the next owner. The pool must outlive its objects
+ */
+template<typename T>
+class ObjectPool
+{
+public:
+    using Factory = std::function<T*()>;
+
+    class Deleter
+    {
+    public:
+        Deleter(ObjectPool<T> *pool = nullptr): m_pool(pool) { }
+        void operator()(T *object) const
+        {
+            if(m_pool != nullptr)
+            {
+                m_pool->Release(object);
+            }
+            else
+            {
+                delete object;
+            }
+        }
+
+    private:
+        ObjectPool<T> *m_pool;
+    };
+
+    using Ptr = std::unique_ptr<T, Deleter>;
+
+    explicit ObjectPool(const Factory &factory = nullptr, size_t capacity = DEFAULT_POOL_CAPACITY):
+        m_factory(factory),
+        m_capacity(capacity)
+    {
+    }
+
+    ~ObjectPool()
+    {
+        for(T *object: m_objects)
+        {
+            delete object;
+        }
+    }
+
+    ObjectPool(const ObjectPool& other) = delete;
+    ObjectPool& operator=(const ObjectPool& other) = delete;
+
+    Ptr Get()
+    {
+        T *object = nullptr;
+        {
+            Lock lock(m_mutex);
+            if(!m_objects.empty())
+            {
+                object = m_objects.back();
+                m_objects.pop_back();
+            }
+        }
+
+        if(object == nullptr)
+        {
+            object = (m_factory != nullptr) ? m_factory() : Create(std::is_default_constructible<T>());
+        }
+
+        return Ptr(object, Deleter(this));
+    }
+
+    void SetCapacity(size_t capacity)
+    {
+        Lock lock(m_mutex);
+        m_capacity = capacity;
+        while(m_objects.size() > m_capacity)
+        {
+            delete m_objects.back();
+            m_objects.pop_back();
+        }
+    }
+
+    size_t GetCapacity() const
+    {
+        return m_capacity;
+    }
+
+    size_t GetCount()
+    {
+        Lock lock(m_mutex);
+        return m_objects.size();
+    }
+
+protected:
+    static T* Create(std::true_type)
+    {
+        return new T();
+    }
+
+    static T* Create(std::false_type)
+    {
+        // such an object can only be created with a factory
+        return nullptr;
+    }
+
+    void Release(T *object)
+    {
+        object->Clear();
+
+        Lock lock(m_mutex);
+        if(m_objects.size() < m_capacity)
+        {
+            m_objects.push_back(object);
+            return;
+        }
+        lock.Unlock();
+
+        delete object;
+    }
+
+private:
+    Factory m_factory;
+    size_t m_capacity;
+    std::vector<T*> m_objects;
+    Mutex m_mutex;
+};
+
+}
+
+#endif // WEBCPP_OBJECT_POOL_H
@@ -21,18 +21,25 @@ public:
     File(const std::string &file, Mode mode);
     ~File();
     bool Open(const std::string &file, Mode mode);
+    bool OpenTemp(const std::string &folder);
     bool Close();
     size_t Read(char *buffer, size_t size);
     size_t Write(const char *buffer, size_t size);
+    bool Link(const std::string &path);
     bool IsOpened() const;
+    bool IsTemp() const;
+    int GetDescriptor() const;
+    size_t GetSize() const;
 
 protected:
     int Mode2Flag(Mode mode);
+    bool CopyTo(const std::string &path);
 
 private:
     std::string m_file;
     Mode m_mode = Mode::Undefined;
     int m_fd = (-1);
+    bool m_temp = false;
 };
 
 inline File::Mode operator |(File::Mode a, File::Mode b)
@@ -25,6 +25,7 @@
 #ifndef WEBCPP_SIGNAL_H
 #define WEBCPP_SIGNAL_H
 
+#include <inttypes.h>
 #include "pthread.h"
 #include "Mutex.h"
 
@@ -38,6 +39,7 @@ public:
     Signal();
     void Fire();
     void Wait(Mutex &mutex);
+    bool Wait(Mutex &mutex, uint32_t timeout);
 
 private:
     pthread_cond_t m_signalCondition = PTHREAD_COND_INITIALIZER;
@@ -27,6 +27,8 @@
 
 #include <poll.h>
 #include <stddef.h>
+#include <atomic>
+#include <sys/uio.h>
 #ifdef WITH_OPENSSL
 #include <openssl/ssl.h>
 #include <openssl/err.h>
@@ -35,6 +37,7 @@
 #include "Mutex.h"
 
 #define POLL_TIMEOUT 500
+#define WRITE_TIMEOUT 30000
 #define DEFAULT_HOST "*"
 #define DEFAULT_PORT 80
 #define DEFAULT_SSL_HOST "*"
@@ -90,12 +93,17 @@ public:
     size_t Accept();
     bool Connect(const std::string &host, int port = 0);
     size_t Write(const uint8_t *buffer, size_t size, size_t index = 0);
+    size_t WriteV(const struct iovec *iov, int count, size_t index = 0);
+    size_t WriteVNoWait(const struct iovec *iov, int count, size_t index = 0);
+    size_t SendFile(int fileFd, size_t offset, size_t size, size_t index = 0);
     size_t Read(void *buffer, size_t size, size_t index = 0);
 
     void SetPollRead();
     void SetPollWrite();
+    void PollWritable(size_t index);
     bool Poll();
     bool HasData(size_t index) const;
+    bool IsWritable(size_t index) const;
     bool IsPollError(size_t index) const;
 
     void SetPort(int port);
@@ -121,6 +129,7 @@ protected:
     void ParseAddress(const std::string &address);
     bool ConnectTcp(const std::string &host, int port);
     bool ConnectUnix(const std::string &host);
+    void WaitForWrite(int fd);
     template <typename T>
     bool IsContains(T v1, T v2)
     {
@@ -139,6 +148,9 @@ private:
     Type m_type = Type::Undefined;
     Options m_options = Options::None;
     struct pollfd *m_fds = nullptr;
+    Mutex *m_writeMutex = nullptr;
+    std::atomic<bool> *m_pollWrite = nullptr;
+    int m_wakeFd = (-1);
 #ifdef WITH_OPENSSL
     std::string m_cert;
     std::string m_key;
@@ -147,7 +159,6 @@ private:
 #endif
     std::string m_host = DEFAULT_HOST;
     int m_port = DEFAULT_PORT;
-    Mutex m_writeMutex;
     int m_connectTimeout = DEFAULT_CONNECT_TIMEOUT;
 };
 
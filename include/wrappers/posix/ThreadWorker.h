@@ -56,6 +56,7 @@ private:
     std::function<ThreadRoutine> m_func = nullptr;
     std::function<ThreadFinishRoutine> m_funcFinish = nullptr;
     bool m_isRunning = false;
+    mutable bool m_joinable = false;
 };
 
 }
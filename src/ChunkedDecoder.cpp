@@ -0,0 +1,197 @@
+#include <algorithm>
+#include "ChunkedDecoder.h"
+
+#define MAX_CHUNK_LINE_LENGTH 1024
+#define MAX_TRAILER_SIZE 8192
+#define MAX_CHUNK_SIZE_DIGITS 15
+
+
+using namespace WebCpp;
+
+ChunkedDecoder::ChunkedDecoder(size_t maxSize):
+    m_maxSize(maxSize)
+{
+
+}
+
+bool ChunkedDecoder::Decode(ByteArray &data, size_t start, size_t &decoded)
+{
+    ClearError();
+
+    size_t read = start;
+    size_t write = start;
+    size_t end = data.size();
+    bool more = true;
+
+    while(more && m_state != State::Complete)
+    {
+        switch(m_state)
+        {
+            case State::Size:
+            case State::Trailer:
+            {
+                auto it = std::find(data.begin() + read, data.begin() + end, LF);
+                if(it == data.begin() + end)
+                {
+                    size_t limit = (m_state == State::Size) ? MAX_CHUNK_LINE_LENGTH : MAX_TRAILER_SIZE - m_trailer.size();
+                    if(end - read > limit)
+                    {
+                        SetLastError(m_state == State::Size ? "chunk size line is too long" : "trailer is too large");
+                        return false;
+                    }
+                    more = false;
+                    break;
+                }
+
+                size_t lf = it - data.begin();
+                size_t lineEnd = (lf > read && data[lf - 1] == CR) ? lf - 1 : lf;
+                if(m_state == State::Size)
+                {
+                    if(ParseSize(data, read, lineEnd) == false)
+                    {
+                        return false;
+                    }
+                }
+                else if(lineEnd == read)
+                {
+                    m_state = State::Complete;
+                }
+                else
+                {
+                    m_trailer.insert(m_trailer.end(), data.begin() + read, data.begin() + lineEnd);
+                    m_trailer.insert(m_trailer.end(), { CRLF });
+                    if(m_trailer.size() > MAX_TRAILER_SIZE)
+                    {
+                        SetLastError("trailer is too large");
+                        return false;
+                    }
+                }
+                read = lf + 1;
+                break;
+            }
+            case State::Data:
+            {
+                size_t length = std::min(m_remaining, end - read);
+                if(read != write)
+                {
+                    std::copy(data.begin() + read, data.begin() + read + length, data.begin() + write);
+                }
+                read += length;
+                write += length;
+                m_remaining -= length;
+                if(m_remaining == 0)
+                {
+                    m_state = State::DataEnd;
+                }
+                else
+                {
+                    more = false;
+                }
+                break;
+            }
+            case State::DataEnd:
+                if(end - read < 2)
+                {
+                    more = false;
+                    break;
+                }
+                if(data[read] != CR || data[read + 1] != LF)
+                {
+                    SetLastError("chunk data is not terminated with CRLF");
+                    return false;
+                }
+                read += 2;
+                m_state = State::Size;
+                break;
+            case State::Complete:
+                break;
+        }
+    }
+
+    // the chunk framing is removed, the unprocessed tail is moved right after the decoded data
+    data.erase(data.begin() + write, data.begin() + read);
+    decoded = write - start;
+
+    return true;
+}
+
+bool ChunkedDecoder::IsComplete() const
+{
+    return (m_state == State::Complete);
+}
+
+bool ChunkedDecoder::IsTooLarge() const
+{
+    return m_tooLarge;
+}
+
+size_t ChunkedDecoder::GetSize() const
+{
+    return m_size;
+}
+
+const ByteArray &ChunkedDecoder::GetTrailer() const
+{
+    return m_trailer;
+}
+
+bool ChunkedDecoder::ParseSize(const ByteArray &data, size_t start, size_t end)
+{
+    // chunk-size [ ; chunk-ext ], the extensions are ignored
+    size_t size = 0;
+    size_t digits = 0;
+    size_t pos = start;
+    for(;pos < end;pos ++)
+    {
+        uint8_t ch = data[pos];
+        int value;
+        if(ch >= '0' && ch <= '9')
+        {
+            value = ch - '0';
+        }
+        else if(ch >= 'a' && ch <= 'f')
+        {
+            value = ch - 'a' + 10;
+        }
+        else if(ch >= 'A' && ch <= 'F')
+        {
+            value = ch - 'A' + 10;
+        }
+        else
+        {
+            break;
+        }
+
+        if(++digits > MAX_CHUNK_SIZE_DIGITS)
+        {
+            SetLastError("chunk size is too large");
+            return false;
+        }
+        size = (size << 4) | static_cast<size_t>(value);
+    }
+
+    if(digits == 0 || (pos < end && data[pos] != ';' && data[pos] != ' ' && data[pos] != '\t'))
+    {
+        SetLastError("wrong chunk size");
+        return false;
+    }
+
+    if(size == 0)
+    {
+        m_state = State::Trailer;
+        return true;
+    }
+
+    if(size > m_maxSize - m_size)
+    {
+        m_tooLarge = true;
+        SetLastError("body exceeds the limit of " + std::to_string(m_maxSize) + " bytes");
+        return false;
+    }
+
+    m_size += size;
+    m_remaining = size;
+    m_state = State::Data;
+
+    return true;
+}
@@ -0,0 +1,350 @@
+#include <chrono>
+#include "Lock.h"
+#include "File.h"
+#include "FileSystem.h"
+#include "StringUtil.h"
+#include "Response.h"
+#include "Data.h"
+#include "defines_webcpp.h"
+#include "FileCache.h"
+
+
+using namespace WebCpp;
+
+static const std::vector<std::pair<std::string, std::string>> precompressedFiles = {
+    { "br", ".br" },
+    { "gzip", ".gz" },
+};
+
+FileCache &FileCache::Instance()
+{
+    static FileCache instance;
+    return instance;
+}
+
+FileCache::EntryPtr FileCache::Get(const std::string &file, const HttpConfig &config)
+{
+    std::string root = FileSystem::NormalizePath(config.GetRoot());
+
+    std::string key = FileSystem::NormalizePath(file, true);
+
+    if(config.GetFileCacheEnabled() == false)
+    {
+        return Load(key, file, root, 0, config.GetPrecompressed());
+    }
+
+    uint64_t now = Now();
+    EntryPtr entry = nullptr;
+
+    {
+        Lock lock(m_mutex);
+        auto it = m_items.find(key);
+        if(it != m_items.end() && it->second.entry->root == root)
+        {
+            auto &item = it->second;
+            m_lru.splice(m_lru.begin(), m_lru, item.position);
+            if(now - item.validated < static_cast<uint64_t>(config.GetFileCacheRevalidate()))
+            {
+                return item.entry;
+            }
+            entry = item.entry;
+        }
+    }
+
+    if(entry != nullptr)
+    {
+        // the entry is outdated, check whether the file was changed since it was loaded
+        if(IsModified(*entry, config.GetPrecompressed()) == false)
+        {
+            Lock lock(m_mutex);
+            auto it = m_items.find(key);
+            if(it != m_items.end() && it->second.entry == entry)
+            {
+                it->second.validated = now;
+            }
+            return entry;
+        }
+    }
+
+    entry = Load(key, file, root, config.GetFileCacheMaxFileSize(), config.GetPrecompressed());
+
+    Lock lock(m_mutex);
+    if(entry == nullptr)
+    {
+        auto it = m_items.find(key);
+        if(it != m_items.end())
+        {
+            m_size -= GetCost(*it->second.entry);
+            m_lru.erase(it->second.position);
+            m_items.erase(it);
+        }
+        return nullptr;
+    }
+
+    Insert(key, entry, now);
+    Evict(config.GetFileCacheSize());
+
+    return entry;
+}
+
+FileCache::EncodedPtr FileCache::GetEncoded(const EntryPtr &entry, const std::string &encoding, const HttpConfig &config)
+{
+    if(entry == nullptr || entry->cached == false)
+    {
+        return nullptr;
+    }
+
+    {
+        Lock lock(m_mutex);
+        auto it = entry->encoded.find(encoding);
+        if(it != entry->encoded.end())
+        {
+            return it->second;
+        }
+    }
+
+    ByteArray data;
+#ifdef WITH_ZLIB
+    int level = config.GetCompressionLevel();
+    switch(_(encoding.c_str()))
+    {
+        case _("gzip"): data = Data::Zip(entry->content, level); break;
+        case _("deflate"): data = Data::Compress(entry->content, level); break;
+        default: break;
+    }
+#endif
+    if(data.empty())
+    {
+        return nullptr;
+    }
+
+    EncodedPtr encoded = std::make_shared<const ByteArray>(std::move(data));
+
+    Lock lock(m_mutex);
+    auto it = entry->encoded.find(encoding);
+    if(it != entry->encoded.end())
+    {
+        return it->second;
+    }
+
+    entry->encoded[encoding] = encoded;
+    auto item = m_items.find(entry->key);
+    if(item != m_items.end() && item->second.entry == entry)
+    {
+        m_size += encoded->size();
+        Evict(config.GetFileCacheSize());
+    }
+
+    return encoded;
+}
+
+void FileCache::Remove(const std::string &file)
+{
+    Lock lock(m_mutex);
+
+    auto it = m_items.find(FileSystem::NormalizePath(file, true));
+    if(it != m_items.end())
+    {
+        m_size -= GetCost(*it->second.entry);
+        m_lru.erase(it->second.position);
+        m_items.erase(it);
+    }
+}
+
+void FileCache::Clear()
+{
+    Lock lock(m_mutex);
+
+    m_items.clear();
+    m_lru.clear();
+    m_size = 0;
+}
+
+size_t FileCache::GetSize() const
+{
+    Lock lock(m_mutex);
+    return m_size;
+}
+
+size_t FileCache::GetCount() const
+{
+    Lock lock(m_mutex);
+    return m_items.size();
+}
+
+std::string FileCache::BuildETag(uint64_t inode, size_t size, time_t modified)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "\"%" PRIx64 "-%zx-%" PRIx64 "\"", inode, size, static_cast<uint64_t>(modified));
+    return buffer;
+}
+
+FileCache::EntryPtr FileCache::Load(const std::string &key, const std::string &file, const std::string &root, size_t maxFileSize, bool precompressed)
+{
+    std::string path = file;
+    FileSystem::FileStat fileStat;
+
+    if(FileSystem::GetFileStat(path, fileStat) == false)
+    {
+        path = root + file;
+        if(FileSystem::GetFileStat(path, fileStat) == false)
+        {
+            return nullptr;
+        }
+    }
+
+    if(fileStat.folder)
+    {
+        return nullptr;
+    }
+
+    std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+    entry->key = key;
+    entry->path = path;
+    entry->root = root;
+    entry->mimeType = Response::Extension2MimeType(FileSystem::ExtractFileExtension(path));
+    entry->lastModified = FileSystem::Time2String(fileStat.modified);
+    entry->etag = BuildETag(fileStat.inode, fileStat.size, fileStat.modified);
+    entry->size = fileStat.size;
+    entry->modified = fileStat.modified;
+    entry->inode = fileStat.inode;
+
+    if(fileStat.size <= maxFileSize)
+    {
+        File f(path, File::Mode::Read);
+        if(f.IsOpened())
+        {
+            entry->content.resize(fileStat.size);
+            size_t pos = 0;
+            while(pos < fileStat.size)
+            {
+                ssize_t bytes = f.Read(reinterpret_cast<char *>(entry->content.data()) + pos, fileStat.size - pos);
+                if(bytes <= 0)
+                {
+                    break;
+                }
+                pos += bytes;
+            }
+
+            if(pos == fileStat.size)
+            {
+                entry->cached = true;
+            }
+            else
+            {
+                entry->content.clear();
+                entry->content.shrink_to_fit();
+            }
+        }
+    }
+
+    if(precompressed)
+    {
+        // a sidecar that is older than the file itself is considered stale
+        for(auto &sidecar: precompressedFiles)
+        {
+            FileSystem::FileStat sidecarStat;
+            if(FileSystem::GetFileStat(path + sidecar.second, sidecarStat) &&
+                    sidecarStat.folder == false &&
+                    sidecarStat.modified >= fileStat.modified)
+            {
+                auto sidecarEntry = Load(key + sidecar.second, path + sidecar.second, root, maxFileSize, false);
+                if(sidecarEntry != nullptr)
+                {
+                    entry->precompressed[sidecar.first] = sidecarEntry;
+                }
+            }
+        }
+    }
+
+    return entry;
+}
+
+bool FileCache::IsModified(const Entry &entry, bool precompressed)
+{
+    FileSystem::FileStat fileStat;
+    if(FileSystem::GetFileStat(entry.path, fileStat) == false ||
+            fileStat.size != entry.size ||
+            fileStat.modified != entry.modified ||
+            fileStat.inode != entry.inode)
+    {
+        return true;
+    }
+
+    if(precompressed)
+    {
+        for(auto &sidecar: precompressedFiles)
+        {
+            FileSystem::FileStat sidecarStat;
+            bool exists = FileSystem::GetFileStat(entry.path + sidecar.second, sidecarStat) &&
+                    sidecarStat.folder == false &&
+                    sidecarStat.modified >= entry.modified;
+            auto it = entry.precompressed.find(sidecar.first);
+            if(exists != (it != entry.precompressed.end()))
+            {
+                return true;
+            }
+            if(exists && (sidecarStat.size != it->second->size ||
+                          sidecarStat.modified != it->second->modified ||
+                          sidecarStat.inode != it->second->inode))
+            {
+                return true;
+            }
+        }
+    }
+    else if(!entry.precompressed.empty())
+    {
+        return true;
+    }
+
+    return false;
+}
+
+size_t FileCache::GetCost(const Entry &entry)
+{
+    size_t cost = sizeof(Entry) + entry.path.size() + entry.content.size();
+    for(auto &encoded: entry.encoded)
+    {
+        cost += encoded.second->size();
+    }
+    for(auto &precompressed: entry.precompressed)
+    {
+        cost += GetCost(*precompressed.second);
+    }
+
+    return cost;
+}
+
+uint64_t FileCache::Now()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FileCache::Insert(const std::string &key, const EntryPtr &entry, uint64_t now)
+{
+    auto it = m_items.find(key);
+    if(it != m_items.end())
+    {
+        m_size -= GetCost(*it->second.entry);
+        m_lru.erase(it->second.position);
+        m_items.erase(it);
+    }
+
+    m_lru.push_front(key);
+    m_items[key] = Item { entry, now, m_lru.begin() };
+    m_size += GetCost(*entry);
+}
+
+void FileCache::Evict(size_t limit)
+{
+    while(m_size > limit && m_lru.size() > 1)
+    {
+        auto it = m_items.find(m_lru.back());
+        if(it != m_items.end())
+        {
+            m_size -= GetCost(*it->second.entry);
+            m_items.erase(it);
+        }
+        m_lru.pop_back();
+    }
+}
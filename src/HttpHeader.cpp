@@ -3,6 +3,7 @@
 #include "StringUtil.h"
 #include "HttpHeader.h"
 
+#define MAX_SPARE_HEADERS 64
 
 using namespace WebCpp;
 
@@ -17,11 +18,11 @@ bool HttpHeader::Parse(const ByteArray &data, size_t start)
 {
     m_complete = false;
 
-    size_t pos = StringUtil::SearchPosition(data, { CRLFCRLF }, start);
+    static const ByteArray delimiter = { CRLFCRLF };
+    size_t pos = StringUtil::SearchPosition(data, delimiter, start);
     if(pos != SIZE_MAX)
     {
-        auto arr = StringUtil::Split(data, { CRLF }, start, pos);
-        if(ParseHeaders(data, arr))
+        if(ParseHeaders(data, start, pos))
         {
             m_headerSize = pos - start;
             m_complete = true;
@@ -33,8 +34,40 @@ bool HttpHeader::Parse(const ByteArray &data, size_t start)
 
 bool HttpHeader::ParseHeader(const ByteArray &data)
 {
-    auto arr = StringUtil::Split(data, { CRLF }, 0, data.size());
-    return ParseHeaders(data, arr);
+    return ParseHeaders(data, 0, data.size());
+}
+
+bool HttpHeader::ParseTrailer(const ByteArray &data)
+{
+    // the fields that control the message framing, routing or authentication are not allowed in a trailer
+    static const std::vector<HeaderType> forbidden = {
+        HeaderType::TransferEncoding,
+        HeaderType::ContentLength,
+        HeaderType::ContentType,
+        HeaderType::ContentEncoding,
+        HeaderType::Host,
+        HeaderType::Authorization,
+        HeaderType::Cookie,
+        HeaderType::Expect,
+        HeaderType::Connection,
+        HeaderType::Upgrade,
+    };
+
+    HttpHeader trailer(m_role);
+    if(trailer.ParseHeader(data) == false)
+    {
+        return false;
+    }
+
+    for(auto &header: trailer.GetHeaders())
+    {
+        if(std::find(forbidden.begin(), forbidden.end(), header.type) == forbidden.end())
+        {
+            SetHeader(header.name, header.value);
+        }
+    }
+
+    return true;
 }
 
 ByteArray HttpHeader::ToByteArray() const
@@ -64,14 +97,12 @@ size_t HttpHeader::GetBodySize() const
 
     if(m_complete)
     {
-        auto str = GetHeader(HeaderType::ContentLength);
+        // Transfer-Encoding overrides Content-Length, RFC 7230, 3.3.3
+        auto str = IsChunked() ? "" : GetHeader(HeaderType::ContentLength);
         if(str.empty() == false)
         {
-            int num;
-            if(StringUtil::String2int(str, num))
-            {
-                size = num;
-            }
+            // an invalid length is rejected by IsBodySizeValid() before the body is read
+            StringUtil::String2size(str, size);
         }
         else
         {
@@ -82,6 +113,24 @@ size_t HttpHeader::GetBodySize() const
     return size;
 }
 
+bool HttpHeader::IsBodySizeValid() const
+{
+    if(IsChunked())
+    {
+        return true;
+    }
+
+    // a malformed or ambiguous length can't be read as some other length, RFC 7230, 3.3.3
+    if(m_lengthConflict)
+    {
+        return false;
+    }
+
+    auto str = GetHeader(HeaderType::ContentLength);
+    size_t size;
+    return str.empty() || StringUtil::String2size(str, size);
+}
+
 size_t HttpHeader::GetRequestSize() const
 {
     return GetHeaderSize() + 4 + GetBodySize(); // header + delimiter(CRLFCRLF, 4 bytes) + body
@@ -92,6 +141,16 @@ void HttpHeader::SetChunckedSize(size_t size)
     m_chunkedSize = size;
 }
 
+bool HttpHeader::IsChunked() const
+{
+    auto str = GetHeader(HeaderType::TransferEncoding);
+    StringUtil::Trim(str);
+    StringUtil::ToLower(str);
+
+    // chunked must be the last encoding applied
+    return (str.size() >= 7 && str.compare(str.size() - 7, 7, "chunked") == 0);
+}
+
 HttpHeader::HeaderRole HttpHeader::GetRole() const
 {
     return m_role;
@@ -102,29 +161,42 @@ void HttpHeader::SetVersion(const std::string &version)
     m_version = version;
 }
 
-bool HttpHeader::ParseHeaders(const ByteArray &data, const StringUtil::Ranges &ranges)
+bool HttpHeader::ParseHeaders(const ByteArray &data, size_t start, size_t end)
 {
-    bool statusLineParsed = false;
+    static const ByteArray delimiter = { CRLF };
+    static const std::string spaces = " \r\n\t";
 
-    for(auto &range: ranges)
+    while(start < end)
     {
-        auto headerDelimiter = StringUtil::SearchPosition(data, { ':' }, range.start, range.end);
-        if(headerDelimiter != SIZE_MAX)
+        size_t lineEnd = StringUtil::SearchPosition(data, delimiter, start, end - 1);
+        if(lineEnd == SIZE_MAX)
         {
-            std::string name = std::string(data.begin() + range.start, data.begin() + headerDelimiter);
-            std::string value = std::string(data.begin() + headerDelimiter + 1, data.begin() + range.end + 1);
-            StringUtil::Trim(name);
-            StringUtil::Trim(value);
+            lineEnd = end;
+        }
 
-            SetHeader(name, value);
+        // the name and the value are passed as views into the buffer so that no temporary strings are created
+        const char *line = reinterpret_cast<const char *>(data.data());
+        auto headerDelimiter = std::find(line + start, line + lineEnd, ':');
+        if(headerDelimiter != line + lineEnd)
+        {
+            const char *name = line + start;
+            const char *nameEnd = headerDelimiter;
+            const char *value = headerDelimiter + 1;
+            const char *valueEnd = line + lineEnd;
+            while(name < nameEnd && spaces.find(*name) != std::string::npos) name ++;
+            while(nameEnd > name && spaces.find(*(nameEnd - 1)) != std::string::npos) nameEnd --;
+            while(value < valueEnd && spaces.find(*value) != std::string::npos) value ++;
+            while(valueEnd > value && spaces.find(*(valueEnd - 1)) != std::string::npos) valueEnd --;
+
+            SetHeader(name, nameEnd - name, value, valueEnd - value);
         }
+
+        start = lineEnd + delimiter.size();
     }
 
     return true;
 }
 
-
-
 HttpHeader::HeaderType HttpHeader::String2HeaderType(const std::string &str)
 {
     switch(_(str.c_str()))
@@ -311,37 +383,109 @@ void HttpHeader::SetHeader(HeaderType type, const std::string &value)
 }
 
 void HttpHeader::SetHeader(const std::string &name, const std::string &value)
+{
+    SetHeader(name.data(), name.size(), value.data(), value.size());
+}
+
+void HttpHeader::SetHeader(const char *name, size_t nameLength, const char *value, size_t valueLength)
 {
     for(auto &header: m_headers)
     {
-        if(header.name == name)
+        if(header.name.compare(0, std::string::npos, name, nameLength) == 0)
         {
-            header.value = value;
+            if(header.type == HeaderType::ContentLength && header.value.compare(0, std::string::npos, value, valueLength) != 0)
+            {
+                m_lengthConflict = true;
+            }
+            header.value.assign(value, valueLength);
             return;
         }
     }
+
+    // reuse a slot left by Clear() to keep the string buffers allocated earlier
     HttpHeader::Header header;
-    header.type = String2HeaderType(name);
-    header.name = name;
-    header.value = value;
+    if(!m_spare.empty())
+    {
+        header = std::move(m_spare.back());
+        m_spare.pop_back();
+    }
+    header.name.assign(name, nameLength);
+    header.value.assign(value, valueLength);
+    header.type = String2HeaderType(header.name);
     m_headers.push_back(std::move(header));
 }
 
+void HttpHeader::RemoveHeader(HeaderType type)
+{
+    if(type == HeaderType::Undefined)
+    {
+        return;
+    }
+
+    for(auto it = m_headers.begin(); it != m_headers.end();)
+    {
+        if(it->type == type)
+        {
+            it = m_headers.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void HttpHeader::RemoveHeader(const std::string &name)
+{
+    for(auto it = m_headers.begin(); it != m_headers.end();)
+    {
+        if(it->name == name)
+        {
+            it = m_headers.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
 void HttpHeader::Clear()
 {
     m_role = HeaderRole::Undefined;
     m_complete = false;
+    for(auto &header: m_headers)
+    {
+        if(m_spare.size() >= MAX_SPARE_HEADERS)
+        {
+            break;
+        }
+        m_spare.push_back(std::move(header));
+    }
     m_headers.clear();
     m_version = "HTTP/1.1";
     m_headerSize = 0;
     m_remoteAddress = "";
     m_remotePort = (-1);
     m_chunkedSize = 0;
+    m_lengthConflict = false;
 }
 
 std::string HttpHeader::GetHeader(HeaderType headerType) const
 {
-    return GetHeader(HttpHeader::HeaderType2String(headerType));
+    // the type is resolved once when the header is set, so no name lookup is needed here
+    if(headerType != HeaderType::Undefined)
+    {
+        for(auto &header: m_headers)
+        {
+            if(header.type == headerType)
+            {
+                return header.value;
+            }
+        }
+    }
+
+    return "";
 }
 
 std::string HttpHeader::GetHeader(const std::string &headerType) const
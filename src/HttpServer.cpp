@@ -8,14 +8,17 @@
 #include "StringUtil.h"
 #include "Request.h"
 #include "KeepAliveTimer.h"
+#include "ClockCache.h"
 #include "Data.h"
 #include "HttpServer.h"
+#include "WebSocketServer.h"
 #include "IHttp.h"
 
 
 using namespace WebCpp;
 
 HttpServer::HttpServer():
+    m_responsePool([this]() { return new Response(-1, m_config); }),
     m_config(WebCpp::HttpConfig::Instance())
 {
 
@@ -70,12 +73,24 @@ bool WebCpp::HttpServer::Init()
     m_server->SetDataReadyCallback(f2);
     auto f3 = std::bind(&HttpServer::OnClosed, this, std::placeholders::_1);
     m_server->SetCloseConnectionCallback(f3);
+    auto f4 = std::bind(&HttpServer::OnHeaderComplete, this, std::placeholders::_1);
+    m_sessions.SetHeaderCallback(f4);
+    auto f5 = std::bind(&HttpServer::OnBodyRejected, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+    m_sessions.SetRejectCallback(f5);
+    m_sessions.SetConfig(m_config);
+#ifdef WITH_WEBSOCKET
+    auto f6 = std::bind(&HttpServer::OnWriteReady, this, std::placeholders::_1);
+    m_server->SetWriteReadyCallback(f6);
+#endif
 
     if(StartRequestThread() == false)
     {
         return false;
     }
 
+    // the clock is shared by the servers, each one releases only its own reference
+    m_clockStarted = ClockCache::Run();
+
     if(m_config.GetKeepAliveTimeout() != 0)
     {
         auto f = std::bind(&HttpServer::ProcessKeepAlive, this, std::placeholders::_1);
@@ -107,6 +122,11 @@ bool HttpServer::Close(bool wait)
     m_server->Close(wait);
     KeepAliveTimer::stop();
     StopRequestThread();
+    if(m_clockStarted)
+    {
+        ClockCache::Stop();
+        m_clockStarted = false;
+    }
     return true;
 }
 
@@ -134,6 +154,16 @@ HttpServer &HttpServer::OnPost(const std::string &path, const RouteHttp::RouteFu
     return *this;
 }
 
+HttpServer &HttpServer::OnPostStream(const std::string &path, const RouteHttp::BodyFunc &body, const RouteHttp::RouteFunc &f, bool needAuth)
+{
+    RouteHttp route(path, Http::Method::POST, needAuth);
+    LOG("register streaming route: " + route.ToString(), LogWriter::LogType::Info);
+    route.SetBodyFunction(body);
+    route.SetFunction(f);
+    m_routes.push_back(std::move(route));
+    return *this;
+}
+
 void HttpServer::SetPreRouteFunc(const RouteHttp::RouteFunc &callback)
 {
     m_preRoute = callback;
@@ -153,7 +183,7 @@ bool HttpServer::SendResponse(Response &response)
 {
     if(response.IsShouldSend())
     {
-        response.AddHeader(HttpHeader::HeaderType::Date, FileSystem::GetDateTime());
+        response.AddHeader(HttpHeader::HeaderType::Date, ClockCache::GetDateTime());
         if(response.Send(m_server.get()) == false)
         {
             LOG("Error sending response: " + response.GetLastError(), LogWriter::LogType::Error);
@@ -163,9 +193,55 @@ bool HttpServer::SendResponse(Response &response)
     return true;
 }
 
+std::shared_ptr<ICommunicationServer> HttpServer::GetCommunicationServer() const
+{
+    return m_server;
+}
+
+#ifdef WITH_WEBSOCKET
+void HttpServer::SetWebSocketServer(WebSocketServer *server)
+{
+    std::vector<int> upgraded;
+
+    {
+        Lock lock(m_queueMutex);
+        m_webSocket = server;
+
+        // nothing is forwarded to the detached server anymore, its connections are closed
+        if(server == nullptr)
+        {
+            for(size_t i = 0;i < m_upgraded.size();i ++)
+            {
+                if(m_upgraded[i])
+                {
+                    upgraded.push_back(i);
+                }
+            }
+            m_upgraded.clear();
+        }
+    }
+
+    // closing calls OnClosed that takes the queue lock again
+    for(int connID: upgraded)
+    {
+        m_server->CloseConnection(connID);
+    }
+}
+#endif
+
 void HttpServer::OnConnected(int connID, const std::string &remote)
 {
     LOG(std::string("client connected: #") + std::to_string(connID) + ", " + remote, LogWriter::LogType::Access);
+#ifdef WITH_WEBSOCKET
+    // the slot was closed but the close notification isn't delivered yet
+    {
+        Lock lock(m_queueMutex);
+        if(m_webSocket != nullptr && ReleaseUpgraded(connID))
+        {
+            m_webSocket->OnClosed(connID);
+        }
+    }
+#endif
     PutToQueue(connID, remote);
     if(m_config.GetKeepAliveTimeout() > 0)
     {
@@ -181,10 +257,32 @@ void HttpServer::OnDataReady(int connID, ByteArray &data)
 
 void HttpServer::OnClosed(int connID)
 {    
+#ifdef WITH_WEBSOCKET
+    {
+        // the websocket server is notified under the lock so it can't be detached meanwhile
+        Lock lock(m_queueMutex);
+        if(m_webSocket != nullptr && ReleaseUpgraded(connID))
+        {
+            m_webSocket->OnClosed(connID);
+        }
+    }
+#endif
     m_sessions.RemoveSession(connID);
     LOG(std::string("http connection closed: #") + std::to_string(connID), LogWriter::LogType::Access);
 }
 
+#ifdef WITH_WEBSOCKET
+// only the websocket output waits for the socket to be writable
+void HttpServer::OnWriteReady(int connID)
+{
+    Lock lock(m_queueMutex);
+    if(m_webSocket != nullptr && IsUpgraded(connID))
+    {
+        m_webSocket->OnWriteReady(connID);
+    }
+}
+#endif
+
 bool HttpServer::StartRequestThread()
 {
     auto f = std::bind(&HttpServer::RequestThread, this, std::placeholders::_1);
@@ -234,6 +332,15 @@ void HttpServer::PutToQueue(int connID, const std::string &remote)
 void HttpServer::AppendData(int connID, const ByteArray &data)
 {
     Lock lock(m_queueMutex);
+#ifdef WITH_WEBSOCKET
+    // the check and the handing over are done under the same lock as the upgrade so no data is lost between them
+    if(m_webSocket != nullptr && IsUpgraded(connID))
+    {
+        m_webSocket->PutToQueue(connID, data);
+        m_webSocket->SendSignal();
+        return;
+    }
+#endif
     m_sessions.AppendData(connID, data);
 }
 
@@ -253,10 +360,19 @@ bool HttpServer::CheckDataFullness()
     return retval;
 }
 
-std::unique_ptr<Request> HttpServer::GetNextRequest()
+RequestPtr HttpServer::GetNextRequest(ResponsePtr &response)
 {
     Lock lock(m_queueMutex);
-    return m_sessions.GetReadyRequest();
+    auto request = m_sessions.GetReadyRequest();
+
+    // taken under the same lock since the session is reset as soon as the next request arrives
+    Session *session = (request != nullptr) ? request->GetSession() : nullptr;
+    if(session != nullptr && request->IsPreRouted())
+    {
+        response = std::move(session->response);
+    }
+
+    return request;
 }
 
 void HttpServer::RemoveFromQueue(int connID)
@@ -266,6 +382,195 @@ void HttpServer::RemoveFromQueue(int connID)
     m_sessions.RemoveSession(connID);
 }
 
+bool HttpServer::OnHeaderComplete(Session &session)
+{
+    // called by SessionManager under the queue lock as soon as the header is received
+    Request &request = *session.request;
+    int connID = request.GetConnectionID();
+
+    if(request.GetHeader().IsBodySizeValid() == false)
+    {
+        LOG("#" + std::to_string(connID) + ": invalid Content-Length: " + request.GetHeader().GetHeader(HttpHeader::HeaderType::ContentLength), LogWriter::LogType::Error);
+        Reject(connID, 400);
+        return false;
+    }
+
+    size_t bodySize = request.GetHeader().GetBodySize();
+
+    bool expectContinue = false;
+    std::string expect = request.GetHeader().GetHeader(HttpHeader::HeaderType::Expect);
+    if(!expect.empty())
+    {
+        StringUtil::ToLower(StringUtil::Trim(expect));
+        if(expect != "100-continue")
+        {
+            Reject(connID, 417);
+            return false;
+        }
+        // HTTP/1.0 clients don't expect an interim response, RFC 7231, 5.1.1
+        expectContinue = (request.GetHttpVersion() == "HTTP/1.1");
+    }
+
+    // the client waits for our decision so the body isn't sent if the request would be refused anyway
+    if(expectContinue && CheckRequest(session) == false)
+    {
+        return false;
+    }
+
+    for(auto &route: m_routes)
+    {
+        auto &bodyFunc = route.GetBodyFunction();
+        if(bodyFunc != nullptr && route.IsMatch(request))
+        {
+            Request *requestPtr = session.request.get();
+            session.bodyFunc = [this, bodyFunc, requestPtr, connID](const uint8_t *data, size_t size) -> bool
+            {
+                bool retval = false;
+                try
+                {
+                    retval = bodyFunc(*requestPtr, data, size);
+                }
+                catch(...) { }
+
+                if(retval == false)
+                {
+                    Reject(connID, 400);
+                }
+                return retval;
+            };
+            break;
+        }
+    }
+
+    if(session.bodyFunc == nullptr)
+    {
+        size_t limit = m_config.GetMaxBodySize();
+        if(m_config.GetTempFile() &&
+                request.GetHeader().GetHeader(HttpHeader::HeaderType::ContentType).compare(0, 19, "multipart/form-data") == 0)
+        {
+            limit = m_config.GetMaxBodyFileSize();
+        }
+
+        if(bodySize > limit)
+        {
+            LOG("#" + std::to_string(connID) + ": request body of " + std::to_string(bodySize) + " bytes exceeds the limit of " + std::to_string(limit), LogWriter::LogType::Error);
+            Reject(connID, 413);
+            return false;
+        }
+
+        // the size of a chunked body is unknown in advance so it's checked while decoding
+        session.bodyLimit = limit;
+    }
+
+    if(expectContinue)
+    {
+        static ByteArray continueResponse = StringUtil::String2ByteArray("HTTP/1.1 100 Continue\r\n\r\n");
+        m_server->Write(connID, continueResponse);
+    }
+
+    return true;
+}
+
+bool HttpServer::CheckRequest(Session &session)
+{
+    // the same checks ProcessRequest() does, but done before the body is received,
+    // the pre-route handler runs only here and its response is the one sent for the request later
+    Request &request = *session.request;
+    auto responsePtr = m_responsePool.Get();
+    Response &response = *responsePtr;
+    response.SetConnectionID(request.GetConnectionID());
+    response.SetSession(&session);
+
+    if(m_preRoute != nullptr)
+    {
+        request.SetPreRouted(true);
+        if(m_preRoute(request, response))
+        {
+            Reject(response);
+            return false;
+        }
+        session.response = std::move(responsePtr);
+    }
+
+    for(auto &route: m_routes)
+    {
+        if(route.IsMatch(request))
+        {
+            if(route.IsUseAuth())
+            {
+                if(Authenticate(request) == false)
+                {
+                    response.NotAuthenticated();
+                    Reject(response);
+                    return false;
+                }
+                request.SetAuthenticated(true);
+            }
+            return true;
+        }
+    }
+
+    if(m_postRoute == nullptr)
+    {
+        response.NotFound();
+        Reject(response);
+        return false;
+    }
+
+    return true;
+}
+
+bool HttpServer::Authenticate(Request &request)
+{
+    auto session = request.GetSession();
+    if(session->authProvider.IsInitialized() == false)
+    {
+        session->authProvider.Init();
+    }
+
+    if(request.CheckAuth() == true && m_authHandler != nullptr)
+    {
+        return m_authHandler(request, session->authProvider.GetPreferred());
+    }
+
+    return false;
+}
+
+void HttpServer::OnBodyRejected(int connID, uint16_t code, const std::string &reason)
+{
+    LOG("#" + std::to_string(connID) + ": request body rejected: " + reason, LogWriter::LogType::Error);
+    Reject(connID, code);
+}
+
+void HttpServer::Reject(int connID, uint16_t code)
+{
+    Response response(connID, m_config);
+    response.SetResponseCode(code);
+    Reject(response);
+}
+
+void HttpServer::Reject(Response &response)
+{
+    // the body is left unread so the connection can't be reused
+    response.AddHeader(HttpHeader::HeaderType::Connection, "close");
+    SendResponse(response);
+    m_rejected.push_back(response.GetConnectionID());
+}
+
+void HttpServer::CloseRejected()
+{
+    std::vector<int> rejected;
+    {
+        Lock lock(m_queueMutex);
+        rejected.swap(m_rejected);
+    }
+
+    for(int connID: rejected)
+    {
+        m_server->CloseConnection(connID);
+    }
+}
+
 void *HttpServer::RequestThread(bool &running)
 {
     while(running)
@@ -273,10 +578,19 @@ void *HttpServer::RequestThread(bool &running)
         WaitForSignal();
         if(running)
         {
-            if(CheckDataFullness())
+            bool ready = CheckDataFullness();
+            CloseRejected();
+            if(ready)
             {
-                auto request = GetNextRequest();
-                ProcessRequest(*request);
+                ResponsePtr response;
+                auto request = GetNextRequest(response);
+#ifdef WITH_WEBSOCKET
+                if(request->GetProtocol() == Http::Protocol::WS && Upgrade(*request))
+                {
+                    continue;
+                }
+#endif
+                ProcessRequest(*request, std::move(response));
             }
         }
     }
@@ -284,20 +598,25 @@ void *HttpServer::RequestThread(bool &running)
     return nullptr;
 }
 
-void HttpServer::ProcessRequest(Request &request)
+void HttpServer::ProcessRequest(Request &request, ResponsePtr responsePtr)
 {
     bool processed = false;
     bool isFinal = false;
 
-    Response response(request.GetConnectionID(), m_config);
-    response.SetSession(request.GetSession());
+    if(responsePtr == nullptr)
+    {
+        responsePtr = m_responsePool.Get();
+        responsePtr->SetConnectionID(request.GetConnectionID());
+        responsePtr->SetSession(request.GetSession());
+    }
+    Response &response = *responsePtr;
 
     if(m_config.GetKeepAliveTimeout() > 0)
     {
         KeepAliveTimer::SetTimer(m_config.GetKeepAliveTimeout(), request.GetConnectionID());
     }
 
-    if(m_preRoute != nullptr)
+    if(m_preRoute != nullptr && request.IsPreRouted() == false)
     {
         processed = m_preRoute(request, response);
     }
@@ -310,22 +629,7 @@ void HttpServer::ProcessRequest(Request &request)
             {
                 if(route.IsUseAuth() == true)
                 {
-                    auto session = request.GetSession();
-                    if(session->authProvider.IsInitialized() == false)
-                    {
-                        session->authProvider.Init();
-                    }
-                    bool authSuccessful = false;
-
-                    if(request.CheckAuth() == true)
-                    {
-                        if(m_authHandler != nullptr)
-                        {
-                            authSuccessful = m_authHandler(request, session->authProvider.GetPreferred());
-                        }
-                    }
-
-                    if(authSuccessful == false)
+                    if(request.IsAuthenticated() == false && Authenticate(request) == false)
                     {
                         response.NotAuthenticated();
                         isFinal = true;
@@ -360,18 +664,187 @@ void HttpServer::ProcessRequest(Request &request)
         }
     }
 
+    if(processed)
+    {
+        const HttpHeader &header = request.GetHeader();
+        // a range always refers to the identity representation so such requests are never compressed
+        if(header.GetHeader(HttpHeader::HeaderType::Range).empty())
+        {
+            response.Compress(header.GetHeader(HttpHeader::HeaderType::AcceptEncoding), request.GetHttpVersion() == "HTTP/1.1");
+        }
+
+        if(IsNotModified(request, response))
+        {
+            response.NotModified();
+        }
+        else
+        {
+            ProcessRange(request, response);
+        }
+    }
+
     LOG("#" + std::to_string(request.GetConnectionID()) + ": " +  request.GetUrl().GetPath() + (processed ? ", processed" : ", not processed"), LogWriter::LogType::Access);
 
     SendResponse(response);
 }
 
+bool HttpServer::IsNotModified(const Request &request, const Response &response) const
+{
+    auto method = request.GetMethod();
+    if((method != Http::Method::GET && method != Http::Method::HEAD) || response.GetResponseCode() != 200)
+    {
+        return false;
+    }
+
+    const HttpHeader &requestHeader = request.GetHeader();
+    const HttpHeader &responseHeader = response.GetHeader();
+
+    // If-None-Match takes precedence over If-Modified-Since, RFC 7232 section 6
+    std::string ifNoneMatch = requestHeader.GetHeader(HttpHeader::HeaderType::IfNoneMatch);
+    if(!ifNoneMatch.empty())
+    {
+        std::string etag = responseHeader.GetHeader(HttpHeader::HeaderType::ETag);
+        if(etag.empty())
+        {
+            return false;
+        }
+        if(etag.compare(0, 2, "W/") == 0)
+        {
+            etag = etag.substr(2);
+        }
+
+        for(auto &tag: StringUtil::Split(ifNoneMatch, ','))
+        {
+            StringUtil::Trim(tag);
+            if(tag == "*")
+            {
+                return true;
+            }
+            if(tag.compare(0, 2, "W/") == 0)
+            {
+                tag = tag.substr(2);
+            }
+            if(tag == etag)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    std::string ifModifiedSince = requestHeader.GetHeader(HttpHeader::HeaderType::IfModifiedSince);
+    if(!ifModifiedSince.empty())
+    {
+        time_t since, modified;
+        if(FileSystem::String2Time(ifModifiedSince, since) &&
+                FileSystem::String2Time(responseHeader.GetHeader(HttpHeader::HeaderType::LastModified), modified))
+        {
+            return modified <= since;
+        }
+    }
+
+    return false;
+}
+
+void HttpServer::ProcessRange(const Request &request, Response &response) const
+{
+    const HttpHeader &requestHeader = request.GetHeader();
+
+    std::string range = requestHeader.GetHeader(HttpHeader::HeaderType::Range);
+    if(range.empty() || request.GetMethod() != Http::Method::GET)
+    {
+        return;
+    }
+
+    // If-Range requires a strong match, otherwise the whole file is sent, RFC 7233 section 3.2
+    std::string ifRange = requestHeader.GetHeader(HttpHeader::HeaderType::IfRange);
+    StringUtil::Trim(ifRange);
+    if(!ifRange.empty())
+    {
+        const HttpHeader &responseHeader = response.GetHeader();
+        if(ifRange.front() == '"' || ifRange.compare(0, 2, "W/") == 0)
+        {
+            if(ifRange != responseHeader.GetHeader(HttpHeader::HeaderType::ETag))
+            {
+                return;
+            }
+        }
+        else if(ifRange != responseHeader.GetHeader(HttpHeader::HeaderType::LastModified))
+        {
+            return;
+        }
+    }
+
+    response.SetRange(range);
+}
+
 void HttpServer::ProcessKeepAlive(int connID)
 {
+#ifdef WITH_WEBSOCKET
+    // the websocket server checks its connections by itself
+    {
+        Lock lock(m_queueMutex);
+        if(m_webSocket != nullptr && IsUpgraded(connID))
+        {
+            return;
+        }
+    }
+#endif
 
     m_server->CloseConnection(connID);
     RemoveFromQueue(connID);
 }
 
+#ifdef WITH_WEBSOCKET
+bool HttpServer::Upgrade(Request &request)
+{
+    int connID = request.GetConnectionID();
+
+    Lock lock(m_queueMutex);
+
+    // the websocket server could be detached meanwhile
+    if(connID < 0 || m_webSocket == nullptr || m_webSocket->CanUpgrade(request) == false)
+    {
+        return false;
+    }
+
+    // the socket stays in the same pool, only the data routing is switched
+    ByteArray data;
+    if(m_sessions.DetachSession(connID, data) == false)
+    {
+        return false;
+    }
+
+    if(static_cast<size_t>(connID) >= m_upgraded.size())
+    {
+        m_upgraded.resize(connID + 1, false);
+    }
+    m_upgraded[connID] = true;
+    m_webSocket->Upgrade(request, data);
+
+    LOG("#" + std::to_string(connID) + ": " + request.GetUrl().GetPath() + ", upgraded to websocket", LogWriter::LogType::Access);
+
+    return true;
+}
+
+bool HttpServer::IsUpgraded(int connID) const
+{
+    return connID >= 0 && static_cast<size_t>(connID) < m_upgraded.size() && m_upgraded[connID];
+}
+
+bool HttpServer::ReleaseUpgraded(int connID)
+{
+    if(IsUpgraded(connID) == false)
+    {
+        return false;
+    }
+
+    m_upgraded[connID] = false;
+    return true;
+}
+#endif
+
 std::string HttpServer::ToString() const
 {
     return m_config.ToString();
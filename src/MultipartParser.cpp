@@ -0,0 +1,192 @@
+#include <algorithm>
+#include "StringUtil.h"
+#include "MultipartParser.h"
+
+#define MAX_PART_HEADER_SIZE 8192
+#define PARSE_SLICE_SIZE 65536
+
+
+using namespace WebCpp;
+
+MultipartParser::MultipartParser(const std::string &boundary)
+{
+    // a delimiter is always preceded by CRLF, the very first one is a special case
+    // so the buffer is started with a fake CRLF
+    m_delimiter = { CRLF, '-', '-' };
+    m_delimiter.insert(m_delimiter.end(), boundary.begin(), boundary.end());
+    m_buffer = { CRLF };
+}
+
+void MultipartParser::SetPartCallback(const PartFunc &callback)
+{
+    m_partCallback = callback;
+}
+
+void MultipartParser::SetDataCallback(const DataFunc &callback)
+{
+    m_dataCallback = callback;
+}
+
+void MultipartParser::SetPartEndCallback(const PartEndFunc &callback)
+{
+    m_partEndCallback = callback;
+}
+
+bool MultipartParser::Parse(const uint8_t *data, size_t size)
+{
+    ClearError();
+
+    // the data is processed by slices so the internal buffer stays small
+    // even if the entire body is passed at once
+    size_t pos = 0;
+    do
+    {
+        size_t length = std::min(size - pos, static_cast<size_t>(PARSE_SLICE_SIZE));
+        if(m_state != State::Epilogue)
+        {
+            m_buffer.insert(m_buffer.end(), data + pos, data + pos + length);
+        }
+        pos += length;
+
+        if(Process() == false)
+        {
+            return false;
+        }
+    }
+    while(pos < size);
+
+    return true;
+}
+
+bool MultipartParser::IsComplete() const
+{
+    return (m_state == State::Epilogue);
+}
+
+bool MultipartParser::Process()
+{
+    while(true)
+    {
+        switch(m_state)
+        {
+            case State::Preamble:
+            case State::Data:
+                if(ProcessData(m_state == State::Preamble) == false)
+                {
+                    return false;
+                }
+                if(m_state == State::Preamble || m_state == State::Data)
+                {
+                    return true;
+                }
+                break;
+            case State::Boundary:
+                if(m_buffer.size() < 2)
+                {
+                    return true;
+                }
+                if(m_buffer[0] == '-' && m_buffer[1] == '-')
+                {
+                    m_state = State::Epilogue;
+                    m_buffer.clear();
+                    return true;
+                }
+                if(m_buffer[0] == CR && m_buffer[1] == LF)
+                {
+                    m_buffer.erase(m_buffer.begin(), m_buffer.begin() + 2);
+                    m_state = State::Header;
+                }
+                else if(m_buffer[0] == ' ' || m_buffer[0] == '\t')
+                {
+                    // transport padding
+                    m_buffer.erase(m_buffer.begin());
+                }
+                else
+                {
+                    SetLastError("malformed boundary");
+                    return false;
+                }
+                break;
+            case State::Header:
+            {
+                size_t pos = 0;
+                size_t length = 2;
+                if(m_buffer.size() < 2 || m_buffer[0] != CR || m_buffer[1] != LF)
+                {
+                    pos = StringUtil::SearchPosition(m_buffer, ByteArray { CRLFCRLF });
+                    length = 4;
+                }
+                if(pos == SIZE_MAX || m_buffer.size() < length)
+                {
+                    if(m_buffer.size() > MAX_PART_HEADER_SIZE)
+                    {
+                        SetLastError("part header is too large");
+                        return false;
+                    }
+                    return true;
+                }
+
+                ByteArray header(m_buffer.begin(), m_buffer.begin() + pos);
+                m_buffer.erase(m_buffer.begin(), m_buffer.begin() + pos + length);
+                m_state = State::Data;
+                if(m_partCallback != nullptr && m_partCallback(header) == false)
+                {
+                    SetLastError("part rejected");
+                    return false;
+                }
+                break;
+            }
+            case State::Epilogue:
+                m_buffer.clear();
+                return true;
+        }
+    }
+
+    return true;
+}
+
+bool MultipartParser::ProcessData(bool preamble)
+{
+    size_t length;
+    auto it = std::search(m_buffer.begin(), m_buffer.end(), m_delimiter.begin(), m_delimiter.end());
+    bool found = (it != m_buffer.end());
+    if(found)
+    {
+        length = it - m_buffer.begin();
+    }
+    else if(m_buffer.size() >= m_delimiter.size())
+    {
+        // the tail could be a beginning of the delimiter so it stays in the buffer
+        length = m_buffer.size() - m_delimiter.size() + 1;
+    }
+    else
+    {
+        return true;
+    }
+
+    if(preamble == false && length > 0 && m_dataCallback != nullptr)
+    {
+        if(m_dataCallback(m_buffer.data(), length) == false)
+        {
+            SetLastError("part data rejected");
+            return false;
+        }
+    }
+
+    if(found)
+    {
+        m_buffer.erase(m_buffer.begin(), m_buffer.begin() + length + m_delimiter.size());
+        if(preamble == false && m_partEndCallback != nullptr && m_partEndCallback() == false)
+        {
+            SetLastError("part rejected");
+            return false;
+        }
+        m_state = State::Boundary;
+    }
+    else
+    {
+        m_buffer.erase(m_buffer.begin(), m_buffer.begin() + length);
+    }
+
+    return true;
+}
@@ -16,7 +16,7 @@ Request::Request():
 
 }
 
-bool Request::Parse(const ByteArray &data)
+bool Request::Parse(const ByteArray &data, bool body)
 {
     ClearError();
 
@@ -24,6 +24,7 @@ bool Request::Parse(const ByteArray &data)
     {
         if(ParseRequestLine(data, m_requestLineLength) == false)
         {
+            m_requestLineLength = 0;
             SetLastError("Request: error parsing request line: " + GetLastError());
             return false;
         }
@@ -37,14 +38,20 @@ bool Request::Parse(const ByteArray &data)
         }
     }
 
-    if(m_header.GetBodySize() > 0)
+    // the body is parsed once, when it's completely received
+    if(body && m_header.GetBodySize() > 0 && data.size() >= GetRequestSize())
     {
-        return ParseBody(data, m_requestLineLength + EOL_LENGTH + m_header.GetHeaderSize() + ENTRY_DELIMITER_LENGTH);
+        return ParseBody(data);
     }
 
     return true;
 }
 
+bool Request::ParseBody(const ByteArray &data)
+{
+    return ParseBody(data, m_requestLineLength + EOL_LENGTH + m_header.GetHeaderSize() + ENTRY_DELIMITER_LENGTH);
+}
+
 bool Request::ParseRequestLine(const ByteArray &data, size_t &pos)
 {
     pos = StringUtil::SearchPosition(data, { CR, LF });
@@ -91,6 +98,16 @@ void Request::SetConnectionID(int connID)
     m_connID = connID;
 }
 
+const HttpConfig &Request::GetConfig() const
+{
+    return *m_config;
+}
+
+void Request::SetConfig(const HttpConfig &config)
+{
+    m_config = &config;
+}
+
 const Url &Request::GetUrl() const
 {
     return m_url;
@@ -129,9 +146,8 @@ std::string Request::GetHttpVersion() const
 
 bool Request::ParseBody(const ByteArray &data, size_t headerSize)
 {
-    WebCpp::HttpConfig &config = WebCpp::HttpConfig::Instance();
     auto contentType = m_header.GetHeader(HttpHeader::HeaderType::ContentType);
-    if(m_requestBody.Parse(data, headerSize, ByteArray(contentType.begin(), contentType.end()), config.GetTempFile()) == false)
+    if(m_requestBody.Parse(data, headerSize, ByteArray(contentType.begin(), contentType.end()), m_config->GetTempFile()) == false)
     {
         SetLastError("body parsing error: " + m_requestBody.GetLastError());
         return false;
@@ -140,6 +156,46 @@ bool Request::ParseBody(const ByteArray &data, size_t headerSize)
     return true;
 }
 
+bool Request::BeginBody()
+{
+    auto contentType = m_header.GetHeader(HttpHeader::HeaderType::ContentType);
+    ByteArray type(contentType.begin(), contentType.end());
+    if(RequestBody::IsStreamable(type) == false)
+    {
+        return false;
+    }
+
+    m_bodyStreamed = m_requestBody.BeginStream(type, m_config->GetTempFile());
+    return m_bodyStreamed;
+}
+
+bool Request::AppendBody(const uint8_t *data, size_t size)
+{
+    // after an error the rest of the body is skipped, the error is reported by EndBody()
+    if(m_requestBody.IsStreaming() == false)
+    {
+        return false;
+    }
+
+    return m_requestBody.AppendStream(data, size);
+}
+
+bool Request::EndBody()
+{
+    if(m_requestBody.EndStream() == false)
+    {
+        SetLastError("body parsing error: " + m_requestBody.GetLastError());
+        return false;
+    }
+
+    return true;
+}
+
+bool Request::IsBodyStreamed() const
+{
+    return m_bodyStreamed;
+}
+
 const RequestBody &Request::GetRequestBody() const
 {
     return m_requestBody;
@@ -248,14 +304,20 @@ bool Request::Send(const std::shared_ptr<ICommunicationClient> &communication)
 
 void Request::Clear()
 {
+    ClearError();
     m_connID = (-1);
     m_url.Clear();
     m_header.Clear();
+    m_method = Http::Method::Undefined;
+    m_httpVersion = "HTTP/1.1";
     m_requestLineLength = 0;
     m_args.clear();
     m_requestBody.Clear();
     m_remote = "";
     m_session = nullptr;
+    m_bodyStreamed = false;
+    m_authenticated = false;
+    m_preRouted = false;
 }
 
 void Request::SetSession(Session *session)
@@ -281,6 +343,26 @@ bool Request::CheckAuth()
     return retval;
 }
 
+bool Request::IsAuthenticated() const
+{
+    return m_authenticated;
+}
+
+void Request::SetAuthenticated(bool authenticated)
+{
+    m_authenticated = authenticated;
+}
+
+bool Request::IsPreRouted() const
+{
+    return m_preRouted;
+}
+
+void Request::SetPreRouted(bool preRouted)
+{
+    m_preRouted = preRouted;
+}
+
 ByteArray Request::BuildRequestLine() const
 {
     const HttpHeader &header = GetHeader();
@@ -4,12 +4,28 @@
 #include "RequestBody.h"
 #include "FileSystem.h"
 #include "File.h"
+#include "MultipartParser.h"
 
 #define WRITE_BIFFER_SIZE 1024
 
 
 using namespace WebCpp;
 
+// uploaded files are spooled into a folder shared by all the requests parsed by the same thread,
+// the files are unnamed so the folder is normally empty and it's removed when the thread exits
+struct SpoolFolder
+{
+    std::string path;
+    ~SpoolFolder()
+    {
+        if(!path.empty())
+        {
+            FileSystem::DeleteFolder(path);
+        }
+    }
+};
+static thread_local SpoolFolder spoolFolder;
+
 RequestBody::ContentValue RequestBody::ContentValue::defaultValue = {};
 
 RequestBody::RequestBody()
@@ -19,32 +35,33 @@ RequestBody::RequestBody()
 
 RequestBody::~RequestBody()
 {
-    if(!m_tempFolder.empty() && FileSystem::IsFileExist(m_tempFolder))
-    {
-        FileSystem::DeleteFolder(m_tempFolder);
-    }
+
 }
 
 RequestBody::RequestBody(RequestBody &&other)
 {
     m_values = std::move(other.m_values);
     m_contentType = other.m_contentType;
-    m_tempFolder = other.m_tempFolder;
+    m_useTempFile = other.m_useTempFile;
+    m_parser = std::move(other.m_parser);
+    m_file = std::move(other.m_file);
+    BindParser();
 
     other.m_contentType = ContentType::Undefined;
-    other.m_tempFolder = "";
 }
 
 RequestBody &RequestBody::operator=(RequestBody &&other)
 {
     m_values = std::move(other.m_values);
     m_contentType = other.m_contentType;
-    m_tempFolder = other.m_tempFolder;
+    m_useTempFile = other.m_useTempFile;
+    m_parser = std::move(other.m_parser);
+    m_file = std::move(other.m_file);
+    BindParser();
 
     other.m_values.clear();
     other.m_values.shrink_to_fit();
     other.m_contentType = ContentType::Undefined;
-    other.m_tempFolder = "";
 
     return *this;
 }
@@ -54,16 +71,6 @@ bool RequestBody::Parse(const ByteArray &data, size_t offset, const ByteArray &c
     ClearError();
     bool retval = false;
 
-    if(useTempFile)
-    {
-        m_tempFolder = FileSystem::TempFolder();
-        if(FileSystem::CreateFolder(m_tempFolder) == false)
-        {
-            SetLastError("error creating temporary folder");
-            return false;
-        }
-    }
-
     auto type = ParseContentType(contentType);
 
     switch(type)
@@ -87,72 +94,161 @@ bool RequestBody::Parse(const ByteArray &data, size_t offset, const ByteArray &c
 
 bool RequestBody::ParseFormData(const ByteArray &data, size_t offset, const ByteArray &contentType, bool useTempFile)
 {
-    bool retval = true;
+    if(BeginStream(contentType, useTempFile) == false)
+    {
+        return false;
+    }
+    if(data.size() > offset && AppendStream(data.data() + offset, data.size() - offset) == false)
+    {
+        return false;
+    }
+
+    return EndStream();
+}
+
+bool RequestBody::BeginStream(const ByteArray &contentType, bool useTempFile)
+{
+    ClearError();
 
     m_contentType = ContentType::FormData;
     auto headers = ParseFields(contentType);
     auto boundary = GetHeader("boundary", headers);
+    if(boundary.empty())
+    {
+        SetLastError("boundary not defined");
+        return false;
+    }
+
+    m_useTempFile = useTempFile;
+
+    m_parser.reset(new MultipartParser(boundary));
+    BindParser();
+
+    return true;
+}
+
+void RequestBody::BindParser()
+{
+    // the callbacks point to the object so they have to follow it when the stream is moved
+    if(m_parser != nullptr)
+    {
+        m_parser->SetPartCallback(std::bind(&RequestBody::OnPartHeader, this, std::placeholders::_1));
+        m_parser->SetDataCallback(std::bind(&RequestBody::OnPartData, this, std::placeholders::_1, std::placeholders::_2));
+        m_parser->SetPartEndCallback(std::bind(&RequestBody::OnPartEnd, this));
+    }
+}
+
+bool RequestBody::AppendStream(const uint8_t *data, size_t size)
+{
+    if(m_parser == nullptr)
+    {
+        SetLastError("stream not started");
+        return false;
+    }
+
+    if(m_parser->Parse(data, size) == false)
+    {
+        if(GetLastError().empty())
+        {
+            SetLastError("multipart parsing error: " + m_parser->GetLastError());
+        }
+        m_parser.reset();
+        m_file.reset();
+        return false;
+    }
+
+    return true;
+}
+
+bool RequestBody::EndStream()
+{
+    if(m_parser == nullptr)
+    {
+        // the stream was interrupted by an error that is already set
+        return false;
+    }
+
+    bool retval = m_parser->IsComplete();
+    if(retval == false)
+    {
+        SetLastError("multipart body is incomplete");
+    }
+    m_parser.reset();
+    m_file.reset();
+
+    return retval;
+}
+
+bool RequestBody::IsStreaming() const
+{
+    return (m_parser != nullptr);
+}
+
+bool RequestBody::IsStreamable(const ByteArray &contentType)
+{
+    return (ParseContentType(contentType) == ContentType::FormData);
+}
 
-    if(!boundary.empty())
+bool RequestBody::OnPartHeader(const ByteArray &header)
+{
+    auto partHeaders = ParseHeaders(header);
+    std::string name, filename;
+    std::string contentType = GetHeader("Content-Type", partHeaders);
+    auto contentDisposition = GetHeader("Content-Disposition", partHeaders);
+    if(!contentDisposition.empty())
     {
-        std::string commonBoundary =  "--" + boundary + std::string { CRLF };
-        std::string finalBoundary = "--" + boundary + "--";
-        size_t end = StringUtil::SearchPositionReverse(data, ByteArray(finalBoundary.begin(), finalBoundary.end()));
-        if(end != SIZE_MAX)
+        auto contentDispositionFields = ParseFields(ByteArray(contentDisposition.begin(), contentDisposition.end()));
+        name = GetHeader("name", contentDispositionFields);
+        filename = GetHeader("filename", contentDispositionFields);
+        StringUtil::Trim(filename,"\" ");
+    }
+
+    m_values.push_back(ContentValue { name, contentType, filename, {}, nullptr });
+
+    if(m_useTempFile && !filename.empty())
+    {
+        // the spool folder is only created when a file actually arrives
+        std::string folder = GetSpoolFolder(true);
+        if(folder.empty())
         {
-            end = end - 1;
+            SetLastError("error creating temporary folder");
+            return false;
         }
 
-        auto ranges = StringUtil::SplitReverse(data, ByteArray(commonBoundary.begin(), commonBoundary.end()), offset, end);
-        for(auto &range: ranges)
+        m_file = std::make_shared<File>();
+        if(m_file->OpenTemp(folder) == false)
         {
-            if(range.end > range.start)
-            {
-                auto chunkHeaderPos = StringUtil::SearchPosition(data, ByteArray{ CRLFCRLF }, range.start, range.end);
-                if(chunkHeaderPos != SIZE_MAX)
-                {
-                    auto chunkHeader = ByteArray(data.begin() + range.start, data.begin() + chunkHeaderPos);
-                    auto chunkHeaders = ParseHeaders(chunkHeader);
-                    std::string name,filename;
-                    std::string contentType = GetHeader("Content-Type", chunkHeaders);
-                    auto contentDisposition = GetHeader("Content-Disposition", chunkHeaders);
-                    if(!contentDisposition.empty())
-                    {
-                        auto contentDispositionFields = ParseFields(ByteArray(contentDisposition.begin(), contentDisposition.end()));
-                        name = GetHeader("name", contentDispositionFields);
-                        filename = GetHeader("filename", contentDispositionFields);
-                        StringUtil::Trim(filename,"\" ");
-
-                        if(useTempFile && !filename.empty())
-                        {
-                            File file(m_tempFolder + "/" + filename, File::Mode::Write);
-                            file.Write(reinterpret_cast<const char*>(data.data() + chunkHeaderPos + 4), range.end - 1 - (chunkHeaderPos + 4));
-
-                            m_values.push_back(ContentValue {
-                                                   name,
-                                                   contentType,
-                                                   filename,
-                                                   {} });
-                        }
-                        else
-                        {
-                            m_values.push_back(ContentValue {
-                                                   name,
-                                                   contentType,
-                                                   filename,
-                                                   ByteArray(data.begin() + chunkHeaderPos + 4, data.begin() + range.end - 1) });
-                        }
-                    }
-                }
-            }
+            SetLastError("error creating file: " + m_file->GetLastError());
+            return false;
         }
+        m_values.back().file = m_file;
     }
-    else
+
+    return true;
+}
+
+bool RequestBody::OnPartData(const uint8_t *data, size_t size)
+{
+    if(m_file != nullptr)
     {
-        SetLastError("boundary not defined");
+        if(m_file->Write(reinterpret_cast<const char*>(data), size) != size)
+        {
+            SetLastError("error writing file");
+            return false;
+        }
+        return true;
     }
 
-    return retval;
+    auto &value = m_values.back();
+    value.data.insert(value.data.end(), data, data + size);
+
+    return true;
+}
+
+bool RequestBody::OnPartEnd()
+{
+    m_file.reset();
+    return true;
 }
 
 bool RequestBody::ParseUrlEncoded(const ByteArray &data, size_t offset, const ByteArray &contentType)
@@ -167,6 +263,10 @@ bool RequestBody::ParseUrlEncoded(const ByteArray &data, size_t offset, const By
         for(auto &value: values)
         {
             auto pair = StringUtil::Split(data, {'='}, value.start, value.end);
+            if(pair.empty())
+            {
+                continue;
+            }
 
             std::string name(data.begin() + pair.at(0).start ,data.begin() + pair.at(0).end + 1);
             std::string val = pair.size() > 1 ? std::string(data.begin() + pair.at(1).start ,data.begin() + pair.at(1).end + 1) : "";
@@ -176,7 +276,8 @@ bool RequestBody::ParseUrlEncoded(const ByteArray &data, size_t offset, const By
                                    name,
                                    std::string(contentType.begin(), contentType.end()),
                                    "",
-                                   ByteArray(val.begin(), val.end()) });
+                                   ByteArray(val.begin(), val.end()),
+                                   nullptr });
         }
     }
     retval = true;
@@ -192,7 +293,8 @@ bool RequestBody::ParseText(const ByteArray &data, size_t offset, const ByteArra
                            "",
                            std::string(contentType.begin(), contentType.end()),
                            "",
-                           ByteArray(data.begin() + offset, data.end())
+                           ByteArray(data.begin() + offset, data.end()),
+                           nullptr
                        });
     retval = true;
     return retval;
@@ -228,17 +330,17 @@ const RequestBody::ContentValue& RequestBody::GetValue(const std::string &name)
 
 void RequestBody::SetValue(const std::string &name, const ByteArray &data, const std::string &contentType)
 {
-    m_values.push_back({ name, contentType, "", data });
+    m_values.push_back({ name, contentType, "", data, nullptr });
 }
 
 void RequestBody::SetValue(const std::string &name, const std::string &fileName, const std::string &contentType)
 {
-    m_values.push_back({ name, contentType, fileName, {} });
+    m_values.push_back({ name, contentType, fileName, {}, nullptr });
 }
 
 std::string RequestBody::GetTempFolder() const
 {
-    return m_tempFolder;
+    return GetSpoolFolder(false);
 }
 
 ByteArray RequestBody::ToByteArray()
@@ -286,9 +388,11 @@ std::string RequestBody::BuildContentType() const
 
 void RequestBody::Clear()
 {
+    m_parser.reset();
+    m_file.reset();
+    m_useTempFile = false;
     m_values.clear();
     m_contentType = ContentType::Undefined;
-    m_tempFolder = "";
     m_boundary = "";
 }
 
@@ -443,7 +547,21 @@ std::string RequestBody::GetHeader(const std::string &name, const std::map<std::
     return "";
 }
 
-RequestBody::ContentType RequestBody::ParseContentType(const ByteArray &contentType) const
+std::string RequestBody::GetSpoolFolder(bool create)
+{
+    if(spoolFolder.path.empty() && create)
+    {
+        std::string path = FileSystem::TempFolder();
+        if(FileSystem::CreateFolder(path))
+        {
+            spoolFolder.path = path;
+        }
+    }
+
+    return spoolFolder.path;
+}
+
+RequestBody::ContentType RequestBody::ParseContentType(const ByteArray &contentType)
 {
     if(StringUtil::SearchPosition(contentType, StringUtil::String2ByteArray("multipart/form-data")) != SIZE_MAX)
     {
@@ -465,3 +583,25 @@ std::string RequestBody::ContentValue::GetDataString() const
 {
     return std::string(data.begin(), data.end());
 }
+
+size_t RequestBody::ContentValue::GetSize() const
+{
+    return (file != nullptr) ? file->GetSize() : data.size();
+}
+
+bool RequestBody::ContentValue::Save(const std::string &path) const
+{
+    if(file != nullptr)
+    {
+        // the spooled file is just given a name, the data isn't copied
+        return file->Link(path);
+    }
+
+    File out(path, File::Mode::Write);
+    if(out.IsOpened() == false)
+    {
+        return false;
+    }
+
+    return (out.Write(reinterpret_cast<const char*>(data.data()), data.size()) == data.size());
+}
@@ -1,6 +1,8 @@
 #include <cstring>
 #include <limits>
+#include <algorithm>
 #include "StringUtil.h"
+#include "Data.h"
 #include "RequestWebSocket.h"
 
 
@@ -11,113 +13,155 @@ RequestWebSocket::RequestWebSocket()
 
 }
 
-bool RequestWebSocket::Parse(const ByteArray &data)
+// the payload is unmasked in place, the frame keeps only its position in the buffer.
+// a data frame can be taken partially once at least minChunk bytes of its payload are received
+bool RequestWebSocket::Parse(ByteArray &data, size_t offset, size_t minChunk)
 {
-    bool retval = false;
+    if(ParseHeader(data, offset) == false)
+    {
+        return false;
+    }
+
+    // the control frames are never fragmented and always taken as a whole, rfc6455#section-5.5
+    size_t available = data.size() - offset - m_headerSize;
+    if(m_length > available && (static_cast<uint8_t>(m_messageType) >= 0x8 || available < minChunk))
+    {
+        return false;
+    }
+
+    m_received = 0;
+    m_payloadOffset = offset + m_headerSize;
+    m_payloadSize = std::min<uint64_t>(m_length, available);
+    m_size = m_headerSize + m_payloadSize;
+    UnmaskPayload(data);
+
+    return true;
+}
 
+// the type and the length of the frame are known as soon as its header is received
+bool RequestWebSocket::ParseHeader(const ByteArray &data, size_t offset)
+{
     WebSocketHeader header;
-    size_t dataSize = data.size();
+    size_t dataSize = data.size() - std::min(offset, data.size());
     size_t headerSize = sizeof(WebSocketHeader);
+    const uint8_t *frame = data.data() + offset;
 
-    if(dataSize >= headerSize)
+    if(dataSize < headerSize)
     {
-        std::memcpy(&header, data.data(), headerSize);
-        m_messageType = static_cast<MessageType>(header.flags1.opcode);
+        return false;
+    }
 
-        uint64_t payloadSize = 0;
-        size_t sizeHeaderSize = 0;
-        switch(header.flags2.PayloadLen)
-        {
-            case 126:
-                sizeHeaderSize = sizeof(WebSocketHeaderLength2);
-                if(dataSize >= headerSize + sizeHeaderSize)
-                {
-                    WebSocketHeaderLength2 length;
-                    const uint8_t* ptr = data.data() + headerSize;
-                    length.length.bytes[0] = *(ptr + 1);
-                    length.length.bytes[1] = *ptr;
-                    payloadSize = length.length.value;
-                }
-                else
-                {
-                    return false;
-                }
-                break;
-            case 127:
-                sizeHeaderSize = sizeof(WebSocketHeaderLength3);
-                if(dataSize >= headerSize + sizeHeaderSize)
-                {
-                    WebSocketHeaderLength3 length;
-                    const uint8_t* ptr = data.data() + headerSize;
-                    for(int i = 0;i < 8;i ++)
-                    {
-                        length.length.bytes[i] = *(ptr + 7 - i);
-                    }
-                    payloadSize = length.length.value;
-                }
-                else
-                {
-                    return false;
-                }
-                break;
-            default:
-                payloadSize = header.flags2.PayloadLen;
-                break;
-        }
+    std::memcpy(&header, frame, headerSize);
 
-        if(payloadSize > 0)
-        {
-            size_t maskHeaderSize = 0;
-            WebSocketHeaderMask mask;
-            size_t headers_size = headerSize + sizeHeaderSize;
-            if(header.flags2.Mask == 1)
+    uint64_t payloadSize = 0;
+    size_t sizeHeaderSize = 0;
+    switch(header.flags2.PayloadLen)
+    {
+        case 126:
+            sizeHeaderSize = sizeof(WebSocketHeaderLength2);
+            if(dataSize >= headerSize + sizeHeaderSize)
             {
-                maskHeaderSize = sizeof(WebSocketHeaderMask);
-                headers_size += maskHeaderSize;
-                if(dataSize >= headers_size)
-                {
-                    std::memcpy(&mask, data.data() + headerSize + sizeHeaderSize, maskHeaderSize);
-                }
-                else
-                {
-                    return false;
-                }
+                WebSocketHeaderLength2 length;
+                const uint8_t* ptr = frame + headerSize;
+                length.length.bytes[0] = *(ptr + 1);
+                length.length.bytes[1] = *ptr;
+                payloadSize = length.length.value;
             }
-
-            size_t messageFullSize = headers_size + payloadSize;
-            if(dataSize >= messageFullSize)
+            else
             {
-                // according to rfc6455#section-5.3 server must ignore unmasked data
-                // but anyway we support such unstandard clients
-                if(header.flags2.Mask == 1)
-                {
-                    ByteArray encoded(payloadSize);
-                    for(size_t i = 0;i < payloadSize;i ++)
-                    {
-                        encoded[i] = data[headers_size + i] ^ mask.bytes[i % 4];
-                    }
-                    m_data.insert(m_data.end(), encoded.begin(), encoded.end());
-                }
-                else
-                {
-                    m_data.insert(m_data.end(),
-                                  data.begin() + headers_size,
-                                  data.begin() + messageFullSize
-                                  );
-                }
-
-                if(header.flags1.FIN == 1)
+                return false;
+            }
+            break;
+        case 127:
+            sizeHeaderSize = sizeof(WebSocketHeaderLength3);
+            if(dataSize >= headerSize + sizeHeaderSize)
+            {
+                WebSocketHeaderLength3 length;
+                const uint8_t* ptr = frame + headerSize;
+                for(int i = 0;i < 8;i ++)
                 {
-                    m_final = true;
-                    retval = true;
+                    length.length.bytes[i] = *(ptr + 7 - i);
                 }
-
-                m_size = messageFullSize;
+                payloadSize = length.length.value;
             }
+            else
+            {
+                return false;
+            }
+            break;
+        default:
+            payloadSize = header.flags2.PayloadLen;
+            break;
+    }
+
+    size_t headers_size = headerSize + sizeHeaderSize;
+    m_masked = (header.flags2.Mask == 1);
+    if(m_masked)
+    {
+        size_t maskHeaderSize = sizeof(WebSocketHeaderMask);
+        if(dataSize >= headers_size + maskHeaderSize)
+        {
+            std::memcpy(&m_mask, frame + headers_size, maskHeaderSize);
+            headers_size += maskHeaderSize;
+        }
+        else
+        {
+            return false;
         }
     }
 
-    return retval;
+    m_messageType = static_cast<MessageType>(header.flags1.opcode);
+    m_final = (header.flags1.FIN == 1);
+    m_compressed = (header.flags1.RSV1 == 1);
+    m_length = payloadSize;
+    m_headerSize = headers_size;
+
+    return true;
+}
+
+// the next portion of the partially received frame, the data starts with the payload
+bool RequestWebSocket::ParseNext(ByteArray &data, size_t offset, size_t minChunk)
+{
+    size_t available = data.size() - std::min(offset, data.size());
+    uint64_t remaining = m_length - m_received;
+    if(available == 0 || (remaining > available && available < minChunk))
+    {
+        return false;
+    }
+
+    m_payloadOffset = offset;
+    m_payloadSize = std::min<uint64_t>(remaining, available);
+    m_size = m_payloadSize;
+    UnmaskPayload(data);
+
+    return true;
+}
+
+bool RequestWebSocket::IsComplete() const
+{
+    return m_received == m_length;
+}
+
+bool RequestWebSocket::IsFirst() const
+{
+    return m_received == m_payloadSize;
+}
+
+uint64_t RequestWebSocket::GetLength() const
+{
+    return m_length;
+}
+
+void RequestWebSocket::UnmaskPayload(ByteArray &data)
+{
+    // according to rfc6455#section-5.3 server must ignore unmasked data
+    // but anyway we support such unstandard clients
+    if(m_masked)
+    {
+        uint8_t *payload = data.data() + m_payloadOffset;
+        Data::Mask(payload, payload, m_payloadSize, m_mask.bytes, m_received);
+    }
+    m_received += m_payloadSize;
 }
 
 bool RequestWebSocket::IsFinal() const
@@ -125,6 +169,19 @@ bool RequestWebSocket::IsFinal() const
     return m_final;
 }
 
+bool RequestWebSocket::IsCompressed() const
+{
+    return m_compressed;
+}
+
+#ifdef WITH_ZLIB
+void RequestWebSocket::SetCompression(WebSocketDeflate *deflate, size_t minSize)
+{
+    m_deflate = deflate;
+    m_compressionMinSize = minSize;
+}
+#endif
+
 MessageType RequestWebSocket::GetType() const
 {
     return m_messageType;
@@ -140,6 +197,16 @@ size_t RequestWebSocket::GetSize() const
     return m_size;
 }
 
+size_t RequestWebSocket::GetPayloadOffset() const
+{
+    return m_payloadOffset;
+}
+
+size_t RequestWebSocket::GetPayloadSize() const
+{
+    return m_payloadSize;
+}
+
 const ByteArray &RequestWebSocket::GetData() const
 {
     return m_data;
@@ -155,16 +222,28 @@ bool RequestWebSocket::Send(ICommunicationClient *communication) const
     try
     {
         ByteArray response;
+        const ByteArray *payload = &m_data;
+        bool compressed = false;
+#ifdef WITH_ZLIB
+        ByteArray deflated;
+        if(m_deflate != nullptr && (m_messageType == MessageType::Text || m_messageType == MessageType::Binary) &&
+           m_data.size() >= m_compressionMinSize && m_deflate->Compress(m_data.data(), m_data.size(), deflated))
+        {
+            payload = &deflated;
+            compressed = true;
+        }
+#endif
 
         WebSocketHeader header = {};
         header.flags1.FIN = 1;
+        header.flags1.RSV1 = compressed ? 1 : 0;
         header.flags1.opcode = static_cast<uint8_t>(m_messageType);
         header.flags2.Mask = 1;
-        size_t dataSize = m_data.size();
+        size_t dataSize = payload->size();
 
         if(dataSize < 126)
         {
-            header.flags2.PayloadLen = m_data.size();
+            header.flags2.PayloadLen = dataSize;
         }
         else
         {
@@ -213,13 +292,9 @@ bool RequestWebSocket::Send(ICommunicationClient *communication) const
         }
         response.insert(response.end(), maskBuffer.begin(), maskBuffer.end());
 
-        ByteArray encoded(m_data.size());
-        for(auto i = 0;i < m_data.size();i ++)
-        {
-            encoded[i] = m_data[i] ^ mask.bytes[i % 4];
-        }
-
-        response.insert(response.end(), encoded.begin(), encoded.end());
+        size_t pos = response.size();
+        response.resize(pos + dataSize);
+        Data::Mask(payload->data(), response.data() + pos, dataSize, mask.bytes);
 
         communication->Write(response);
 
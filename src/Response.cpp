@@ -1,14 +1,20 @@
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
 #include "common_webcpp.h"
 #include "defines_webcpp.h"
 #include "FileSystem.h"
 #include "File.h"
+#include "FileCache.h"
 #include "Response.h"
 #include "IHttp.h"
 #include "Data.h"
 #include "SessionManager.h"
 #include "DebugPrint.h"
 
-#define WRITE_BIFFER_SIZE 1024
+#define MAX_RANGES 16
+#define BOUNDARY_LENGTH 20
+#define STREAM_BUFFER_SIZE 65536
 
 
 using namespace WebCpp;
@@ -39,7 +45,6 @@ void Response::AddHeader(HttpHeader::HeaderType header, const std::string &value
 void Response::Write(const ByteArray &data, size_t start)
 {
     m_body.insert(m_body.end(), data.begin() + start, data.end());
-    AddHeader(HttpHeader::HeaderType::ContentLength, std::to_string(m_body.size()));
 }
 
 void Response::Write(const std::string &data)
@@ -50,25 +55,17 @@ void Response::Write(const std::string &data)
 bool Response::AddFile(const std::string &file, const std::string &charset)
 {
     bool retval = false;
-    std::string path;
 
-    if(FileSystem::IsFileExist(file) == false)
+    auto entry = FileCache::Instance().Get(file, m_config);
+    if(entry != nullptr)
     {
-        std::string root = FileSystem::NormalizePath(m_config.GetRoot());
-        path = root + file;
-    }
-    else
-    {
-        path = file;
-    }
-
-    if(FileSystem::IsFileExist(path))
-    {
-        std::string ext = FileSystem::ExtractFileExtension(path);
-        AddHeader(HttpHeader::HeaderType::ContentType, Response::Extension2MimeType(ext) + ";charset=" + charset);
-        AddHeader(HttpHeader::HeaderType::ContentLength, std::to_string(FileSystem::GetFileSize(path)));
-        AddHeader(HttpHeader::HeaderType::LastModified, FileSystem::GetFileModifiedTime(path));
-        m_file = path;
+        AddHeader(HttpHeader::HeaderType::ContentType, entry->mimeType + ";charset=" + charset);
+        AddHeader(HttpHeader::HeaderType::ContentLength, std::to_string(entry->size));
+        AddHeader(HttpHeader::HeaderType::LastModified, entry->lastModified);
+        AddHeader(HttpHeader::HeaderType::ETag, entry->etag);
+        AddHeader(HttpHeader::HeaderType::AcceptRanges, "bytes");
+        m_file = entry->path;
+        m_fileEntry = entry;
         retval = true;
     }
     else
@@ -87,6 +84,21 @@ bool Response::NotFound()
     return true;
 }
 
+bool Response::NotModified()
+{
+    m_responseCode = 304;
+    m_responsePhrase = Response::ResponseCode2String(m_responseCode);
+    m_body.clear();
+    m_file.clear();
+    m_fileEntry = nullptr;
+    m_encoded = nullptr;
+    m_streamEncoding = EncodingType::Undefined;
+    m_header.RemoveHeader(HttpHeader::HeaderType::ContentType);
+    m_header.RemoveHeader(HttpHeader::HeaderType::ContentLength);
+    m_header.RemoveHeader(HttpHeader::HeaderType::TransferEncoding);
+    return true;
+}
+
 bool Response::Redirect(const std::string &url)
 {
     m_responseCode = 301;
@@ -168,10 +180,24 @@ void Response::SetShouldSend(bool value)
     m_shouldSend = value;
 }
 
+void Response::SetStreamFunction(const StreamFunc &func)
+{
+    m_streamFunc = func;
+    m_header.RemoveHeader(HttpHeader::HeaderType::ContentLength);
+    AddHeader(HttpHeader::HeaderType::TransferEncoding, "chunked");
+}
+
 bool Response::Send(ICommunicationServer *communication)
 {
     ByteArray header;
 
+    // the body size is known only now, a status without a body doesn't need it at all
+    bool streamed = (m_streamFunc != nullptr || m_streamEncoding != EncodingType::Undefined);
+    if(streamed == false && m_file.empty() && m_responseCode >= 200 && m_responseCode != 204 && m_responseCode != 304)
+    {
+        AddHeader(HttpHeader::HeaderType::ContentLength, std::to_string(m_body.size()));
+    }
+
     const ByteArray &sl = BuildStatusLine();
     header.insert(header.end(), sl.begin(), sl.end());
 
@@ -180,6 +206,22 @@ bool Response::Send(ICommunicationServer *communication)
     header.push_back(CR);
     header.push_back(LF);
 
+    if(m_fileEntry != nullptr && m_fileEntry->cached && m_ranges.empty())
+    {
+        const ByteArray &content = (m_encoded != nullptr) ? *m_encoded : m_fileEntry->content;
+        struct iovec iov[2];
+        iov[0].iov_base = header.data();
+        iov[0].iov_len = header.size();
+        iov[1].iov_base = const_cast<uint8_t *>(content.data());
+        iov[1].iov_len = content.size();
+        if(communication->WriteV(m_connID, iov, 2) == false)
+        {
+            SetLastError("error sending file: " + communication->GetLastError());
+            return false;
+        }
+        return true;
+    }
+
     if(communication->Write(m_connID, header) == false)
     {
         SetLastError("error sending header: " + communication->GetLastError());
@@ -188,38 +230,61 @@ bool Response::Send(ICommunicationServer *communication)
 
     if(!m_file.empty())
     {
-        ByteArray buffer(WRITE_BIFFER_SIZE);
-        if(FileSystem::IsFileExist(m_file))
+        File file;
+        if(m_fileEntry == nullptr || m_fileEntry->cached == false)
         {
-            size_t size = FileSystem::GetFileSize(m_file);
-            File file(m_file, File::Mode::Read);
-            if(file.IsOpened())
+            if(file.Open(m_file, File::Mode::Read) == false)
             {
-                size_t pos = 0;
-                while(pos < size)
-                {
-                    ssize_t bytes = file.Read(reinterpret_cast<char *>(buffer.data()), WRITE_BIFFER_SIZE);
-                    if(bytes == ERROR)
-                    {
-                        break;
-                    }
-                    pos += bytes;
-                    if(communication->Write(m_connID, buffer, bytes) == false)
-                    {
-                        SetLastError("error sending file: " + communication->GetLastError());
-                        return false;
-                    }
-                }
+                SetLastError("file " + m_file + " failed to open");
+                return false;
             }
-            else
+        }
+
+        if(m_streamEncoding != EncodingType::Undefined)
+        {
+            return SendFileEncoded(communication, file.GetDescriptor());
+        }
+
+        if(m_ranges.empty())
+        {
+            size_t size = (m_fileEntry != nullptr) ? m_fileEntry->size : FileSystem::GetFileSize(m_file);
+            return SendFileRange(communication, file.GetDescriptor(), 0, size);
+        }
+
+        for(auto &range: m_ranges)
+        {
+            if(!range.header.empty() && communication->Write(m_connID, range.header) == false)
+            {
+                SetLastError("error sending range header: " + communication->GetLastError());
+                return false;
+            }
+            if(SendFileRange(communication, file.GetDescriptor(), range.start, range.length) == false)
             {
-                SetLastError("file " + m_file + " failed to open");
                 return false;
             }
         }
-        else
+
+        if(!m_rangesTail.empty() && communication->Write(m_connID, m_rangesTail) == false)
+        {
+            SetLastError("error sending range header: " + communication->GetLastError());
+            return false;
+        }
+    }
+    else if(m_streamFunc != nullptr)
+    {
+        Writer writer(communication, m_connID);
+        bool retval = false;
+        try
+        {
+            retval = m_streamFunc(writer);
+        }
+        catch(...) { }
+
+        // the client can only detect an aborted stream by the missing last chunk
+        if(retval == false || writer.Finish() == false)
         {
-            SetLastError("file " + m_file + " not exists");
+            SetLastError("error sending stream: " + (writer.IsError() ? communication->GetLastError() : "aborted by handler"));
+            communication->CloseConnection(m_connID);
             return false;
         }
     }
@@ -235,6 +300,323 @@ bool Response::Send(ICommunicationServer *communication)
     return true;
 }
 
+bool Response::SetRange(const std::string &range)
+{
+    if(m_fileEntry == nullptr || m_responseCode != 200)
+    {
+        return false;
+    }
+
+    std::string value = range;
+    StringUtil::Trim(value);
+    if(value.compare(0, 6, "bytes=") != 0)
+    {
+        return false;
+    }
+
+    size_t size = m_fileEntry->size;
+    std::vector<Range> ranges;
+    auto specs = StringUtil::Split(value.substr(6), ',');
+    if(specs.empty() || specs.size() > MAX_RANGES)
+    {
+        return false;
+    }
+
+    for(auto &spec: specs)
+    {
+        StringUtil::Trim(spec);
+        size_t delimiter = spec.find('-');
+        if(delimiter == std::string::npos)
+        {
+            return false;
+        }
+
+        std::string first = spec.substr(0, delimiter);
+        std::string last = spec.substr(delimiter + 1);
+        size_t start, end;
+
+        if(first.empty())
+        {
+            size_t suffix;
+            if(String2Size(last, suffix) == false)
+            {
+                return false;
+            }
+            if(suffix == 0 || size == 0)
+            {
+                continue;
+            }
+            start = (suffix < size) ? size - suffix : 0;
+            end = size - 1;
+        }
+        else
+        {
+            if(String2Size(first, start) == false)
+            {
+                return false;
+            }
+            if(last.empty())
+            {
+                end = size - 1;
+            }
+            else if(String2Size(last, end) == false || end < start)
+            {
+                return false;
+            }
+            if(start >= size)
+            {
+                continue;
+            }
+            end = std::min(end, size - 1);
+        }
+
+        ranges.push_back(Range { start, end - start + 1, {} });
+    }
+
+    if(ranges.empty())
+    {
+        m_responseCode = 416;
+        m_responsePhrase = Response::ResponseCode2String(m_responseCode);
+        m_file.clear();
+        m_fileEntry = nullptr;
+        m_header.RemoveHeader(HttpHeader::HeaderType::ContentType);
+        AddHeader(HttpHeader::HeaderType::ContentRange, "bytes */" + std::to_string(size));
+        AddHeader(HttpHeader::HeaderType::ContentLength, "0");
+        return true;
+    }
+
+    m_responseCode = 206;
+    m_responsePhrase = Response::ResponseCode2String(m_responseCode);
+
+    if(ranges.size() == 1)
+    {
+        auto &r = ranges.front();
+        AddHeader(HttpHeader::HeaderType::ContentRange, "bytes " + std::to_string(r.start) + "-" +
+                  std::to_string(r.start + r.length - 1) + "/" + std::to_string(size));
+        AddHeader(HttpHeader::HeaderType::ContentLength, std::to_string(r.length));
+    }
+    else
+    {
+        std::string boundary = StringUtil::GenerateRandomString(BOUNDARY_LENGTH, true, false);
+        std::string contentType = m_header.GetHeader(HttpHeader::HeaderType::ContentType);
+        size_t length = 0;
+        for(auto &r: ranges)
+        {
+            std::string header = "\r\n--" + boundary + "\r\n" +
+                    "Content-Type: " + contentType + "\r\n" +
+                    "Content-Range: bytes " + std::to_string(r.start) + "-" +
+                    std::to_string(r.start + r.length - 1) + "/" + std::to_string(size) + "\r\n\r\n";
+            r.header = StringUtil::String2ByteArray(header);
+            length += r.header.size() + r.length;
+        }
+        m_rangesTail = StringUtil::String2ByteArray("\r\n--" + boundary + "--\r\n");
+        length += m_rangesTail.size();
+
+        AddHeader(HttpHeader::HeaderType::ContentType, "multipart/byteranges; boundary=" + boundary);
+        AddHeader(HttpHeader::HeaderType::ContentLength, std::to_string(length));
+    }
+
+    m_ranges = std::move(ranges);
+
+    return true;
+}
+
+bool Response::Compress(const std::string &acceptEncoding, bool chunked)
+{
+    if(m_responseCode != 200 || !m_header.GetHeader(HttpHeader::HeaderType::ContentEncoding).empty())
+    {
+        return false;
+    }
+
+    if(m_fileEntry != nullptr && !m_fileEntry->precompressed.empty())
+    {
+        AddHeader(HttpHeader::HeaderType::Vary, "Accept-Encoding");
+
+        std::vector<EncodingType> available;
+        for(auto type: { EncodingType::Brotli, EncodingType::Gzip })
+        {
+            if(m_fileEntry->precompressed.count(EncodingType2String(type)) > 0)
+            {
+                available.push_back(type);
+            }
+        }
+
+        EncodingType encoding = NegotiateEncoding(acceptEncoding, available);
+        if(encoding != EncodingType::Undefined)
+        {
+            std::string token = EncodingType2String(encoding);
+            auto sidecar = m_fileEntry->precompressed.at(token);
+            m_fileEntry = sidecar;
+            m_file = sidecar->path;
+            AddHeader(HttpHeader::HeaderType::ContentLength, std::to_string(sidecar->size));
+            AddHeader(HttpHeader::HeaderType::ETag, sidecar->etag);
+            AddHeader(HttpHeader::HeaderType::ContentEncoding, token);
+            return true;
+        }
+    }
+
+#ifdef WITH_ZLIB
+    if(m_config.GetCompressionEnabled() == false)
+    {
+        return false;
+    }
+
+    size_t size;
+    if(m_fileEntry != nullptr)
+    {
+        size = m_fileEntry->size;
+    }
+    else if(m_file.empty())
+    {
+        size = m_body.size();
+    }
+    else
+    {
+        return false;
+    }
+
+    std::string mimeType = m_header.GetHeader(HttpHeader::HeaderType::ContentType);
+    mimeType = mimeType.substr(0, mimeType.find(';'));
+    StringUtil::Trim(mimeType);
+    if(size < m_config.GetCompressionMinSize() || IsCompressible(mimeType) == false)
+    {
+        return false;
+    }
+
+    // the representation depends on Accept-Encoding even if this client doesn't get it compressed
+    AddHeader(HttpHeader::HeaderType::Vary, "Accept-Encoding");
+
+    EncodingType encoding = NegotiateEncoding(acceptEncoding, { EncodingType::Gzip, EncodingType::Deflate });
+    if(encoding == EncodingType::Undefined)
+    {
+        return false;
+    }
+
+    std::string token = EncodingType2String(encoding);
+    int level = m_config.GetCompressionLevel();
+
+    if(m_fileEntry != nullptr)
+    {
+        if(m_fileEntry->cached)
+        {
+            auto encoded = FileCache::Instance().GetEncoded(m_fileEntry, token, m_config);
+            if(encoded == nullptr || encoded->size() >= size)
+            {
+                return false;
+            }
+            m_encoded = encoded;
+            AddHeader(HttpHeader::HeaderType::ContentLength, std::to_string(encoded->size()));
+        }
+        else
+        {
+            if(chunked == false)
+            {
+                return false;
+            }
+            m_streamEncoding = encoding;
+            m_header.RemoveHeader(HttpHeader::HeaderType::ContentLength);
+            AddHeader(HttpHeader::HeaderType::TransferEncoding, "chunked");
+        }
+
+        std::string etag = m_fileEntry->etag;
+        etag.insert(etag.size() - 1, "-" + token);
+        AddHeader(HttpHeader::HeaderType::ETag, etag);
+    }
+    else
+    {
+        ByteArray data = (encoding == EncodingType::Gzip) ? Data::Zip(m_body, level) : Data::Compress(m_body, level);
+        if(data.empty() || data.size() >= m_body.size())
+        {
+            return false;
+        }
+        m_body = std::move(data);
+    }
+
+    AddHeader(HttpHeader::HeaderType::ContentEncoding, token);
+
+    return true;
+#else
+    (void)acceptEncoding;
+    (void)chunked;
+    return false;
+#endif
+}
+
+Response::Writer::Writer(ICommunicationServer *communication, int connID) :
+    m_communication(communication),
+    m_connID(connID)
+{
+
+}
+
+bool Response::Writer::Write(const uint8_t *data, size_t size)
+{
+    if(m_error)
+    {
+        return false;
+    }
+    if(size == 0)
+    {
+        return true;
+    }
+
+    char chunkSize[24];
+    struct iovec iov[3];
+    iov[0].iov_base = chunkSize;
+    iov[0].iov_len = snprintf(chunkSize, sizeof(chunkSize), "%zx\r\n", size);
+    iov[1].iov_base = const_cast<uint8_t *>(data);
+    iov[1].iov_len = size;
+    iov[2].iov_base = const_cast<char *>("\r\n");
+    iov[2].iov_len = 2;
+
+    // blocks while the socket output buffer is full so the handler can't outrun the client
+    if(m_communication->WriteV(m_connID, iov, 3) == false)
+    {
+        m_error = true;
+        return false;
+    }
+
+    m_written += size;
+    return true;
+}
+
+bool Response::Writer::Write(const ByteArray &data)
+{
+    return Write(data.data(), data.size());
+}
+
+bool Response::Writer::Write(const std::string &data)
+{
+    return Write(reinterpret_cast<const uint8_t *>(data.data()), data.size());
+}
+
+size_t Response::Writer::GetWritten() const
+{
+    return m_written;
+}
+
+bool Response::Writer::IsError() const
+{
+    return m_error;
+}
+
+bool Response::Writer::Finish()
+{
+    if(m_error)
+    {
+        return false;
+    }
+
+    ByteArray last = { '0', CR, LF, CR, LF };
+    if(m_communication->Write(m_connID, last) == false)
+    {
+        m_error = true;
+        return false;
+    }
+
+    return true;
+}
+
 bool Response::Parse(const ByteArray &data, size_t* all, size_t* downoaded)
 {
     ClearError();
@@ -320,6 +702,130 @@ bool Response::Parse(const ByteArray &data, size_t* all, size_t* downoaded)
     return false;
 }
 
+bool Response::SendFileRange(ICommunicationServer *communication, int fd, size_t offset, size_t length)
+{
+    if(length == 0)
+    {
+        return true;
+    }
+
+    bool retval;
+    if(m_fileEntry != nullptr && m_fileEntry->cached)
+    {
+        struct iovec iov;
+        iov.iov_base = const_cast<uint8_t *>(m_fileEntry->content.data()) + offset;
+        iov.iov_len = length;
+        retval = communication->WriteV(m_connID, &iov, 1);
+    }
+    else
+    {
+        retval = communication->SendFile(m_connID, fd, offset, length);
+    }
+
+    if(retval == false)
+    {
+        SetLastError("error sending file: " + communication->GetLastError());
+    }
+
+    return retval;
+}
+
+bool Response::SendFileEncoded(ICommunicationServer *communication, int fd)
+{
+#ifdef WITH_ZLIB
+    Data::Deflater deflater(m_streamEncoding == EncodingType::Gzip ? Data::Deflater::Format::Gzip : Data::Deflater::Format::Zlib,
+                            m_config.GetCompressionLevel());
+    if(deflater.IsValid() == false)
+    {
+        SetLastError("failed to initialize the compressor");
+        return false;
+    }
+
+    ByteArray buffer(STREAM_BUFFER_SIZE);
+    ByteArray out;
+    bool finish = false;
+    while(finish == false)
+    {
+        ssize_t bytes = read(fd, buffer.data(), buffer.size());
+        if(bytes < 0)
+        {
+            SetLastError("file " + m_file + " read error");
+            return false;
+        }
+        finish = (bytes == 0);
+
+        out.clear();
+        if(deflater.Process(buffer.data(), bytes, out, finish) == false)
+        {
+            SetLastError("compression error");
+            return false;
+        }
+
+        if(!out.empty() || finish)
+        {
+            char chunkSize[24];
+            int chunkSizeLength = snprintf(chunkSize, sizeof(chunkSize), "%zx\r\n", out.size());
+            std::string chunkEnd = finish ? (out.empty() ? "0\r\n\r\n" : "\r\n0\r\n\r\n") : "\r\n";
+            struct iovec iov[3];
+            iov[0].iov_base = chunkSize;
+            iov[0].iov_len = out.empty() ? 0 : chunkSizeLength;
+            iov[1].iov_base = out.data();
+            iov[1].iov_len = out.size();
+            iov[2].iov_base = const_cast<char *>(chunkEnd.data());
+            iov[2].iov_len = chunkEnd.size();
+            if(communication->WriteV(m_connID, iov, 3) == false)
+            {
+                SetLastError("error sending file: " + communication->GetLastError());
+                return false;
+            }
+        }
+    }
+
+    return true;
+#else
+    (void)communication;
+    (void)fd;
+    return false;
+#endif
+}
+
+bool Response::IsCompressible(const std::string &mimeType) const
+{
+    if(mimeType.empty())
+    {
+        return false;
+    }
+
+    for(auto &type: StringUtil::Split(m_config.GetCompressionTypes(), ','))
+    {
+        StringUtil::Trim(type);
+        if(type == mimeType)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Response::String2Size(const std::string &str, size_t &value)
+{
+    if(str.empty() || str.find_first_not_of("0123456789") != std::string::npos)
+    {
+        return false;
+    }
+
+    errno = 0;
+    unsigned long long number = strtoull(str.c_str(), nullptr, 10);
+    if(errno == ERANGE || number > SIZE_MAX)
+    {
+        return false;
+    }
+
+    value = static_cast<size_t>(number);
+    return true;
+}
+
 bool Response::DecodeBody(EncodingType type, const ByteArray& data, size_t pos)
 {
     switch(type)
@@ -388,6 +894,84 @@ Response::EncodingType Response::String2EncodingType(const std::string &str)
     return Response::EncodingType::Undefined;
 }
 
+std::string Response::EncodingType2String(EncodingType type)
+{
+    switch(type)
+    {
+        case Response::EncodingType::Gzip: return "gzip";
+        case Response::EncodingType::Deflate: return "deflate";
+        case Response::EncodingType::Chunked: return "chunked";
+        case Response::EncodingType::Compress: return "compress";
+        case Response::EncodingType::Brotli: return "br";
+        default: break;
+    }
+
+    return "";
+}
+
+Response::EncodingType Response::NegotiateEncoding(const std::string &acceptEncoding, const std::vector<EncodingType> &available)
+{
+    std::map<EncodingType, double> weights;
+    double any = -1;
+
+    for(auto &item: StringUtil::Split(acceptEncoding, ','))
+    {
+        auto params = StringUtil::Split(item, ';');
+        if(params.empty())
+        {
+            continue;
+        }
+
+        std::string coding = params[0];
+        StringUtil::Trim(coding);
+        StringUtil::ToLower(coding);
+
+        double q = 1.0;
+        for(size_t i = 1;i < params.size();i ++)
+        {
+            std::string param = params[i];
+            StringUtil::Trim(param);
+            if(param.compare(0, 2, "q=") == 0)
+            {
+                q = atof(param.c_str() + 2);
+            }
+        }
+
+        if(coding == "*")
+        {
+            any = q;
+        }
+        else if(coding == "x-gzip")
+        {
+            weights[EncodingType::Gzip] = q;
+        }
+        else
+        {
+            auto type = String2EncodingType(coding);
+            if(type != EncodingType::Undefined)
+            {
+                weights[type] = q;
+            }
+        }
+    }
+
+    // the order of the available encodings is the server preference for equal weights
+    EncodingType retval = EncodingType::Undefined;
+    double best = 0;
+    for(auto type: available)
+    {
+        auto it = weights.find(type);
+        double q = (it == weights.end()) ? any : it->second;
+        if(q > best)
+        {
+            best = q;
+            retval = type;
+        }
+    }
+
+    return retval;
+}
+
 bool Response::ParseStatusLine(const ByteArray &data, size_t &pos)
 {
     pos = StringUtil::SearchPosition(data, { CR, LF });
@@ -588,3 +1172,32 @@ Session *Response::GetSession() const
 {
     return m_session;
 }
+
+int Response::GetConnectionID() const
+{
+    return m_connID;
+}
+
+void Response::SetConnectionID(int connID)
+{
+    m_connID = connID;
+}
+
+void Response::Clear()
+{
+    ClearError();
+    m_connID = (-1);
+    m_header.Clear();
+    m_body.clear();
+    m_responsePhrase = "";
+    m_file = "";
+    m_fileEntry = nullptr;
+    m_ranges.clear();
+    m_encoded = nullptr;
+    m_streamEncoding = EncodingType::Undefined;
+    m_streamFunc = nullptr;
+    m_rangesTail.clear();
+    m_shouldSend = true;
+    m_session = nullptr;
+    InitDefault();
+}
@@ -2,7 +2,9 @@
 
 #include <limits>
 #include <cstring>
+#include <algorithm>
 #include "common_ws.h"
+#include "Data.h"
 #include "ResponseWebSocket.h"
 
 
@@ -18,6 +20,11 @@ bool ResponseWebSocket::IsEmpty() const
     return (m_messageType == MessageType::Undefined);
 }
 
+int ResponseWebSocket::GetConnectionID() const
+{
+    return m_connID;
+}
+
 void ResponseWebSocket::WriteText(const ByteArray &data)
 {
     m_data = data;
@@ -55,64 +62,76 @@ const ByteArray &ResponseWebSocket::GetData() const
     return m_data;
 }
 
-bool ResponseWebSocket::Send(ICommunicationServer *communication) const
+ByteArray ResponseWebSocket::ToByteArray() const
 {
-    try
+    ByteArray frame;
+    const ByteArray *payload = &m_data;
+    bool compressed = false;
+#ifdef WITH_ZLIB
+    ByteArray deflated;
+    if(m_deflate != nullptr && (m_messageType == MessageType::Text || m_messageType == MessageType::Binary) &&
+       m_data.size() >= m_compressionMinSize && m_deflate->Compress(m_data.data(), m_data.size(), deflated))
     {
-        ByteArray response;
+        payload = &deflated;
+        compressed = true;
+    }
+#endif
 
-        WebSocketHeader header = {};
-        header.flags1.FIN = 1;
-        header.flags1.opcode = static_cast<uint8_t>(m_messageType);
-        header.flags2.Mask = 0;
-        size_t dataSize = m_data.size();
+    WebSocketHeader header = {};
+    header.flags1.FIN = 1;
+    header.flags1.RSV1 = compressed ? 1 : 0;
+    header.flags1.opcode = static_cast<uint8_t>(m_messageType);
+    header.flags2.Mask = 0;
+    size_t dataSize = payload->size();
 
-        if(dataSize < 126)
+    if(dataSize < 126)
+    {
+        header.flags2.PayloadLen = dataSize;
+    }
+    else
+    {
+        if(dataSize <= std::numeric_limits<uint16_t>::max())
         {
-            header.flags2.PayloadLen = m_data.size();
+            header.flags2.PayloadLen = 126;
         }
         else
         {
-            if(dataSize <= std::numeric_limits<uint16_t>::max())
-            {
-                header.flags2.PayloadLen = 126;
-            }
-            else
-            {
-                header.flags2.PayloadLen = 127;
-            }
+            header.flags2.PayloadLen = 127;
         }
+    }
 
-        auto const ptr = reinterpret_cast<char*>(&header);
-        ByteArray buffer(ptr, ptr + sizeof(header));
-        response.insert(response.end(), buffer.begin(), buffer.end());
+    frame.reserve(sizeof(header) + sizeof(WebSocketHeaderLength3) + dataSize);
+    auto const ptr = reinterpret_cast<uint8_t*>(&header);
+    frame.insert(frame.end(), ptr, ptr + sizeof(header));
 
-        if(dataSize >= 126 && dataSize <= std::numeric_limits<uint16_t>::max())
-        {
-            WebSocketHeaderLength2 lengthHeader = {};
-            lengthHeader.length.value = dataSize;
-            ByteArray buffer(sizeof(lengthHeader));
-            buffer[0] = lengthHeader.length.bytes[1];
-            buffer[1] = lengthHeader.length.bytes[0];
-            response.insert(response.end(), buffer.begin(), buffer.end());
-        }
-        else if(dataSize > std::numeric_limits<uint16_t>::max())
+    if(dataSize >= 126 && dataSize <= std::numeric_limits<uint16_t>::max())
+    {
+        WebSocketHeaderLength2 lengthHeader = {};
+        lengthHeader.length.value = dataSize;
+        frame.push_back(lengthHeader.length.bytes[1]);
+        frame.push_back(lengthHeader.length.bytes[0]);
+    }
+    else if(dataSize > std::numeric_limits<uint16_t>::max())
+    {
+        WebSocketHeaderLength3 lengthHeader = {};
+        lengthHeader.length.value = dataSize;
+        for(int i = 0;i < 8;i ++)
         {
-            WebSocketHeaderLength3 lengthHeader = {};
-            lengthHeader.length.value = dataSize;
-            ByteArray buffer(sizeof(lengthHeader));
-            for(int i = 0;i < 8;i ++)
-            {
-                buffer[i] = lengthHeader.length.bytes[7 - i];
-            }
-            response.insert(response.end(), buffer.begin(), buffer.end());
+            frame.push_back(lengthHeader.length.bytes[7 - i]);
         }
+    }
 
-        response.insert(response.end(), m_data.begin(), m_data.end());
+    frame.insert(frame.end(), payload->begin(), payload->end());
 
-        communication->Write(m_connID, response);
+    return frame;
+}
 
-        return true;
+bool ResponseWebSocket::Send(ICommunicationServer *communication) const
+{
+    try
+    {
+        ByteArray response = ToByteArray();
+        return communication->Write(m_connID, response);
     }
     catch(...)
     {
@@ -120,42 +139,73 @@ bool ResponseWebSocket::Send(ICommunicationServer *communication) const
     }
 }
 
-bool ResponseWebSocket::Parse(const ByteArray &data)
+bool ResponseWebSocket::Parse(const ByteArray &data, size_t offset)
 {
     WebSocketHeader header;
-    const uint8_t *ptr = data.data();
-    std::memcpy(&header, ptr, sizeof(header));
-    unsigned long long size = 0;
+    size_t dataSize = data.size() - std::min(offset, data.size());
     size_t headerSize = sizeof(header);
-    if(header.flags2.PayloadLen >= 126)
+    const uint8_t *ptr = data.data() + offset;
+
+    if(dataSize < headerSize)
     {
-        if(header.flags2.PayloadLen == 126)
-        {
-            WebSocketHeaderLength2 lengthHeader;
-            std::memcpy(&lengthHeader, ptr + sizeof(header), sizeof(lengthHeader));
-            headerSize += sizeof(lengthHeader);
-            size = lengthHeader.length.value;
-        }
-        else
+        return false;
+    }
+    std::memcpy(&header, ptr, sizeof(header));
+
+    // the length is sent in the network byte order
+    uint64_t size = header.flags2.PayloadLen;
+    size_t lengthSize = (size == 126 ? 2 : (size == 127 ? 8 : 0));
+    if(dataSize < headerSize + lengthSize)
+    {
+        return false;
+    }
+    if(lengthSize > 0)
+    {
+        size = 0;
+        for(size_t i = 0;i < lengthSize;i ++)
         {
-            WebSocketHeaderLength3 lengthHeader;
-            std::memcpy(&lengthHeader, ptr + sizeof(header), sizeof(lengthHeader));
-            headerSize += sizeof(lengthHeader);
-            size = lengthHeader.length.value;
+            size = (size << 8) | ptr[headerSize + i];
         }
+        headerSize += lengthSize;
     }
-    else
+    if(header.flags2.Mask == 1)
     {
-        size = header.flags2.PayloadLen;
+        headerSize += sizeof(WebSocketHeaderMask);
     }
 
-    if(data.size() >= size + headerSize)
+    if(dataSize < headerSize || size > dataSize - headerSize)
     {
-        m_data.insert(m_data.end(), data.begin() + headerSize, data.begin() + headerSize + size);
-        return true;
+        return false;
     }
 
-    return false;
+    m_data.assign(ptr + headerSize, ptr + headerSize + size);
+    if(header.flags2.Mask == 1)
+    {
+        Data::Mask(m_data.data(), m_data.data(), m_data.size(), ptr + headerSize - sizeof(WebSocketHeaderMask));
+    }
+    m_messageType = static_cast<MessageType>(header.flags1.opcode);
+    m_compressed = (header.flags1.RSV1 == 1);
+    m_size = headerSize + size;
+
+    return true;
+}
+
+size_t ResponseWebSocket::GetSize() const
+{
+    return m_size;
+}
+
+bool ResponseWebSocket::IsCompressed() const
+{
+    return m_compressed;
+}
+
+#ifdef WITH_ZLIB
+void ResponseWebSocket::SetCompression(WebSocketDeflate *deflate, size_t minSize)
+{
+    m_deflate = deflate;
+    m_compressionMinSize = minSize;
 }
+#endif
 
 #endif
@@ -19,3 +19,14 @@ const RouteHttp::RouteFunc &RouteHttp::GetFunction() const
 {
     return m_func;
 }
+
+bool RouteHttp::SetBodyFunction(const BodyFunc &f)
+{
+    m_bodyFunc = f;
+    return true;
+}
+
+const RouteHttp::BodyFunc &RouteHttp::GetBodyFunction() const
+{
+    return m_bodyFunc;
+}
@@ -33,4 +33,36 @@ const RouteWebSocket::RouteFuncMessage &RouteWebSocket::GetFunctionMessage() con
     return m_funcMessage;
 }
 
+bool RouteWebSocket::SetFunctionChunk(const RouteWebSocket::RouteFuncChunk &f)
+{
+    m_funcChunk = f;
+    return true;
+}
+
+const RouteWebSocket::RouteFuncChunk &RouteWebSocket::GetFunctionChunk() const
+{
+    return m_funcChunk;
+}
+
+bool RouteWebSocket::SetFunctionView(const RouteWebSocket::RouteFuncView &f)
+{
+    m_funcView = f;
+    return true;
+}
+
+const RouteWebSocket::RouteFuncView &RouteWebSocket::GetFunctionView() const
+{
+    return m_funcView;
+}
+
+void RouteWebSocket::SetMaxMessageSize(size_t size)
+{
+    m_maxMessageSize = size;
+}
+
+size_t RouteWebSocket::GetMaxMessageSize() const
+{
+    return m_maxMessageSize;
+}
+
 #endif
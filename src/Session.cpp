@@ -4,13 +4,23 @@
 
 using namespace WebCpp;
 
-Session::Session(int connID, const std::string &remote):
-    request(new Request()),
+Session::Session(const std::string &remote):
     authProvider(AuthProvider::Type::Server)
 {
     this->remote = remote;
-    request->SetConnectionID(connID);
-    request->SetRemote(remote);
-    request->SetSession(this);
     readyForDispatch = false;
 }
+
+void Session::Reset(int connID, RequestPtr request)
+{
+    this->request = std::move(request);
+    this->request->SetConnectionID(connID);
+    this->request->SetRemote(remote);
+    this->request->SetSession(this);
+    headerChecked = false;
+    bodyFunc = nullptr;
+    bodyReceived = 0;
+    bodyLimit = SIZE_MAX;
+    chunkedDecoder.reset();
+    response.reset();
+}
@@ -1,5 +1,6 @@
 #include "SessionManager.h"
 #include "AuthFactory.h"
+#include <algorithm>
 
 
 using namespace WebCpp;
@@ -9,15 +10,51 @@ SessionManager::SessionManager()
 
 }
 
+void SessionManager::SetHeaderCallback(const HeaderCallback &callback)
+{
+    m_headerCallback = callback;
+}
+
+void SessionManager::SetRejectCallback(const RejectCallback &callback)
+{
+    m_rejectCallback = callback;
+}
+
+void SessionManager::SetConfig(const HttpConfig &config)
+{
+    m_config = &config;
+}
+
+// the request parses its body with the settings of the server it's received by
+RequestPtr SessionManager::NewRequest()
+{
+    auto request = m_requestPool.Get();
+    if(m_config != nullptr)
+    {
+        request->SetConfig(*m_config);
+    }
+    return request;
+}
+
 bool SessionManager::AddNewSession(int connID, const std::string &remote)
 {
     auto it = m_sesions.find(connID);
     if(it == m_sesions.end())
     {
-        m_sesions.insert(std::pair<int, Session>(connID, Session(connID, remote)));
+        auto result = m_sesions.insert(std::pair<int, Session>(connID, Session(remote)));
+        auto &session = result.first->second;
+        session.Reset(connID, NewRequest());
         return true;
     }
 
+    // the connection ID was reused, nothing from the previous connection should leak into the new one
+    auto &session = it->second;
+    session.data.clear();
+    session.remote = remote;
+    session.readyForDispatch = false;
+    session.closing = false;
+    session.Reset(connID, NewRequest());
+
     return false;
 }
 
@@ -27,12 +64,15 @@ bool SessionManager::AppendData(int connID, const ByteArray &data)
     if(it != m_sesions.end())
     {
         auto &session = it->second;
+        if(session.closing)
+        {
+            return false;
+        }
 
         session.data.insert(session.data.end(), data.begin(), data.end());
         if(session.request == nullptr)
         {
-            session.request.reset(new Request(connID, session.remote));
-            session.request->SetSession(&session);
+            session.Reset(connID, NewRequest());
         }
         return true;
     }
@@ -48,15 +88,145 @@ bool SessionManager::Process()
     for(auto& it: m_sesions)
     {
         auto &session = it.second;
+        if(session.closing)
+        {
+            session.data.clear();
+            continue;
+        }
+
+        // the request waits for dispatch, the data after it is not parsed yet
+        if(session.readyForDispatch)
+        {
+            continue;
+        }
+
         if(session.request != nullptr && session.data.size() > 0)
         {
-            if(session.request->Parse(session.data))
+            if(session.request->Parse(session.data, false))
             {
+                if(session.headerChecked == false)
+                {
+                    session.headerChecked = true;
+                    if(m_headerCallback != nullptr && m_headerCallback(session) == false)
+                    {
+                        session.closing = true;
+                        session.data.clear();
+                        continue;
+                    }
+
+                    if(session.request->GetHeader().IsChunked())
+                    {
+                        session.chunkedDecoder.reset(new ChunkedDecoder(session.bodyLimit));
+                    }
+
+                    // multipart body is parsed while it's received so the files are not kept in memory
+                    Request *request = session.request.get();
+                    if(session.bodyFunc == nullptr &&
+                            (request->GetHeader().GetBodySize() > 0 || session.chunkedDecoder != nullptr) &&
+                            request->BeginBody())
+                    {
+                        session.bodyFunc = [request](const uint8_t *data, size_t size) -> bool
+                        {
+                            request->AppendBody(data, size);
+                            return true;
+                        };
+                    }
+                }
+
                 size_t size = session.request->GetRequestSize();
+                if(session.chunkedDecoder != nullptr)
+                {
+                    // the decoded body is accumulated right after the header, unless it's handed over as it comes
+                    auto &header = session.request->GetHeader();
+                    size_t headerSize = size - header.GetBodySize();
+                    size_t start = (session.bodyFunc == nullptr) ? size : headerSize;
+                    size_t decoded = 0;
+                    if(session.data.size() > start && session.chunkedDecoder->Decode(session.data, start, decoded) == false)
+                    {
+                        auto &decoder = *session.chunkedDecoder;
+                        SetLastError("chunked body error: " + decoder.GetLastError());
+                        if(m_rejectCallback != nullptr)
+                        {
+                            m_rejectCallback(it.first, decoder.IsTooLarge() ? 413 : 400, decoder.GetLastError());
+                        }
+                        session.closing = true;
+                        session.data.clear();
+                        continue;
+                    }
+
+                    if(session.bodyFunc != nullptr)
+                    {
+                        bool accepted = (decoded == 0) || session.bodyFunc(session.data.data() + headerSize, decoded);
+                        session.data.erase(session.data.begin() + headerSize, session.data.begin() + headerSize + decoded);
+                        session.bodyReceived += decoded;
+                        if(accepted == false)
+                        {
+                            session.closing = true;
+                            session.data.clear();
+                            continue;
+                        }
+                    }
+                    else
+                    {
+                        header.SetChunckedSize(header.GetBodySize() + decoded);
+                    }
+
+                    if(session.chunkedDecoder->IsComplete() == false)
+                    {
+                        continue;
+                    }
+
+                    header.ParseTrailer(session.chunkedDecoder->GetTrailer());
+                    size = session.request->GetRequestSize();
+                    session.data.resize(size);
+                }
+                else if(session.bodyFunc != nullptr)
+                {
+                    // the body is handed over as it comes, only the header stays in the buffer
+                    size_t bodySize = session.request->GetHeader().GetBodySize();
+                    size_t headerSize = size - bodySize;
+                    if(session.data.size() > headerSize)
+                    {
+                        size_t length = std::min(session.data.size() - headerSize, bodySize - session.bodyReceived);
+                        bool accepted = session.bodyFunc(session.data.data() + headerSize, length);
+                        session.data.erase(session.data.begin() + headerSize, session.data.begin() + headerSize + length);
+                        session.bodyReceived += length;
+                        if(accepted == false)
+                        {
+                            session.closing = true;
+                            session.data.clear();
+                            continue;
+                        }
+                    }
+                    size = headerSize + (bodySize - session.bodyReceived);
+                }
+
                 if(session.data.size() >= size)
                 {
+                    if(session.request->IsBodyStreamed())
+                    {
+                        if(session.request->EndBody() == false)
+                        {
+                            SetLastError("parsing error: " + session.request->GetLastError());
+                        }
+                    }
+                    else if(session.bodyFunc == nullptr && session.request->GetHeader().GetBodySize() > 0)
+                    {
+                        if(session.request->ParseBody(session.data) == false)
+                        {
+                            SetLastError("parsing error: " + session.request->GetLastError());
+                        }
+                    }
                     session.readyForDispatch = true;
-                    session.data.clear();
+                    // the data following the upgrade request belongs to the new protocol
+                    if(session.request->GetProtocol() == Http::Protocol::WS && session.data.size() > size)
+                    {
+                        session.data.erase(session.data.begin(), session.data.begin() + size);
+                    }
+                    else
+                    {
+                        session.data.clear();
+                    }
                     retval = true;
                     break;
                 }
@@ -71,7 +241,7 @@ bool SessionManager::Process()
     return retval;
 }
 
-std::unique_ptr<Request> SessionManager::GetReadyRequest()
+RequestPtr SessionManager::GetReadyRequest()
 {
     for(auto& it: m_sesions)
     {
@@ -79,13 +249,18 @@ std::unique_ptr<Request> SessionManager::GetReadyRequest()
         if(session.readyForDispatch == true)
         {
             session.readyForDispatch = false;
-            return std::unique_ptr<Request>(std::move(session.request));
+            return std::move(session.request);
         }
     }
 
     return nullptr;
 }
 
+RequestPool &SessionManager::GetRequestPool()
+{
+    return m_requestPool;
+}
+
 bool SessionManager::RemoveSession(int connID)
 {
     auto it = m_sesions.find(connID);
@@ -98,6 +273,23 @@ bool SessionManager::RemoveSession(int connID)
     return false;
 }
 
+bool SessionManager::DetachSession(int connID, ByteArray &data)
+{
+    auto it = m_sesions.find(connID);
+    if(it == m_sesions.end())
+    {
+        return false;
+    }
+
+    // the session stays inactive until the connection ID is reused
+    auto &session = it->second;
+    data.swap(session.data);
+    session.data.clear();
+    session.closing = true;
+
+    return true;
+}
+
 bool SessionManager::IsEmpty() const
 {
     return m_sesions.empty();
@@ -75,6 +75,13 @@ bool WebSocketClient::Open(Request &request)
     m_key = Data::Base64Encode(StringUtil::GenerateRandomString(16));
     header.SetHeader("Sec-WebSocket-Key", m_key);
     header.SetHeader("Sec-WebSocket-Version", WS_VERSION);
+#ifdef WITH_ZLIB
+    m_deflate.reset();
+    if(m_config.GetWsCompressionEnabled())
+    {
+        header.SetHeader("Sec-WebSocket-Extensions", WebSocketDeflate::GetOffer());
+    }
+#endif
     if(request.Send(m_connection) == false)
     {
         SetLastError("request sending error: " + request.GetLastError());
@@ -113,6 +120,9 @@ bool WebSocketClient::SendText(const ByteArray &data)
     RequestWebSocket request;
     request.SetType(MessageType::Text);
     request.SetData(data);
+#ifdef WITH_ZLIB
+    request.SetCompression(m_deflate.get(), m_config.GetWsCompressionMinSize());
+#endif
     return request.Send(m_connection.get());
 }
 
@@ -126,6 +136,9 @@ bool WebSocketClient::SendBinary(const ByteArray &data)
     RequestWebSocket request;
     request.SetType(MessageType::Binary);
     request.SetData(data);
+#ifdef WITH_ZLIB
+    request.SetCompression(m_deflate.get(), m_config.GetWsCompressionMinSize());
+#endif
     return request.Send(m_connection.get());
 }
 
@@ -192,9 +205,10 @@ void WebSocketClient::OnDataReady(const ByteArray &data)
                     {
                         h = header.GetHeader("Sec-WebSocket-Accept");
                         std::string key = m_key + WEBSOCKET_KEY_TOKEN;
-                        uint8_t *buffer = Data::Sha1Digest(key);
-                        key = Data::Base64Encode(buffer, 20);
-                        if(h == key)
+                        uint8_t digest[20];
+                        Data::Sha1Digest(reinterpret_cast<const uint8_t *>(key.data()), key.size(), digest);
+                        key = Data::Base64Encode(digest, 20);
+                        if(h == key && InitCompression(header.GetHeader("Sec-WebSocket-Extensions")))
                         {
                             SetState(State::BinaryMessage);
                             if(m_connectCallback != nullptr)
@@ -203,7 +217,7 @@ void WebSocketClient::OnDataReady(const ByteArray &data)
                             }
                             return;
                         }
-                        else
+                        else if(GetLastError().empty())
                         {
                             SetLastError("incorrect response key");
                         }
@@ -239,17 +253,67 @@ void WebSocketClient::OnDataReady(const ByteArray &data)
     else if(m_state == State::BinaryMessage)
     {
         m_data.insert(m_data.end(), data.begin(), data.end());
+
+        // the portion of data can contain several frames as well as the part of the next one
+        size_t offset = 0;
         ResponseWebSocket response(0);
-        if(response.Parse(m_data) == true)
+        while(response.Parse(m_data, offset) == true)
         {
+            offset += response.GetSize();
+            if(response.IsCompressed())
+            {
+                ByteArray message;
+                MessageType type = response.GetMessageType();
+#ifdef WITH_ZLIB
+                if(m_deflate == nullptr || m_deflate->Decompress(response.GetData().data(), response.GetData().size(), message) == false)
+#endif
+                {
+                    SetLastError("failed to decompress the message");
+                    LOG(GetLastError(), LogWriter::LogType::Error);
+                    if(m_errorCallback != nullptr)
+                    {
+                        m_errorCallback(GetLastError());
+                    }
+                    m_data.clear();
+                    Close(false);
+                    return;
+                }
+                response.WriteBinary(message);
+                response.SetMessageType(type);
+            }
+
             if(m_messageCallback != nullptr)
             {
                 m_messageCallback(response);
             }
+        }
+        m_data.erase(m_data.begin(), m_data.begin() + offset);
+    }
+}
 
-            m_data.clear();
+bool WebSocketClient::InitCompression(const std::string &extension)
+{
+    if(extension.empty())
+    {
+        return true;
+    }
+
+#ifdef WITH_ZLIB
+    // the server is allowed to accept only the extension that was offered
+    WebSocketDeflate::Params params;
+    if(m_config.GetWsCompressionEnabled() && WebSocketDeflate::ParseResponse(extension, params))
+    {
+        m_deflate.reset(new WebSocketDeflate(params, false, m_config.GetCompressionLevel()));
+        if(m_deflate->IsValid())
+        {
+            return true;
         }
+        m_deflate.reset();
     }
+#endif
+
+    SetLastError("unsupported extension: " + extension);
+    return false;
 }
 
 void WebSocketClient::OnClosed()
@@ -0,0 +1,277 @@
+#ifdef WITH_ZLIB
+
+#include <algorithm>
+#include "StringUtil.h"
+#include "defines_webcpp.h"
+#include "WebSocketDeflate.h"
+
+#define EXTENSION_NAME "permessage-deflate"
+#define MIN_WINDOW_BITS 8
+#define MAX_WINDOW_BITS 15
+// zlib doesn't support the raw deflate stream with the window of 256 bytes
+#define MIN_DEFLATE_WINDOW_BITS 9
+#define MEM_LEVEL 8
+#define DEFLATE_STATE_SIZE 6_Kb
+#define INFLATE_STATE_SIZE 7_Kb
+
+
+using namespace WebCpp;
+
+static const uint8_t tail[] = { 0x00, 0x00, 0xff, 0xff };
+
+WebSocketDeflate::WebSocketDeflate(const Params &params, bool server, int level):
+    m_deflater(Data::Deflater::Format::Raw, level, server ? params.serverMaxWindowBits : params.clientMaxWindowBits, MEM_LEVEL),
+    m_inflater(Data::Deflater::Format::Raw, server ? params.clientMaxWindowBits : params.serverMaxWindowBits),
+    m_resetDeflater(server ? params.serverNoContextTakeover : params.clientNoContextTakeover),
+    m_resetInflater(server ? params.clientNoContextTakeover : params.serverNoContextTakeover),
+    m_memory(EstimateMemory(params))
+{
+
+}
+
+bool WebSocketDeflate::IsValid() const
+{
+    return m_deflater.IsValid() && m_inflater.IsValid();
+}
+
+bool WebSocketDeflate::Compress(const uint8_t *data, size_t size, ByteArray &out)
+{
+    size_t start = out.size();
+    if(m_deflater.Flush(data, size, out) == false)
+    {
+        return false;
+    }
+
+    // the flushed stream ends with an empty stored block that the receiver adds by itself, RFC 7692, 7.2.1
+    if(out.size() - start >= sizeof(tail) && std::equal(tail, tail + sizeof(tail), out.end() - sizeof(tail)))
+    {
+        out.resize(out.size() - sizeof(tail));
+    }
+
+    if(m_resetDeflater)
+    {
+        m_deflater.Reset();
+    }
+
+    return true;
+}
+
+// the message can be inflated by parts, the stream is finished with the last one
+bool WebSocketDeflate::Decompress(const uint8_t *data, size_t size, ByteArray &out, size_t limit, bool last)
+{
+    if(m_inflater.Process(data, size, out, limit) == false)
+    {
+        return false;
+    }
+
+    if(last == false)
+    {
+        return true;
+    }
+
+    if(m_inflater.Process(tail, sizeof(tail), out, limit) == false)
+    {
+        return false;
+    }
+
+    if(m_resetInflater)
+    {
+        m_inflater.Reset();
+    }
+
+    return true;
+}
+
+size_t WebSocketDeflate::GetMemoryUsage() const
+{
+    return m_memory;
+}
+
+bool WebSocketDeflate::Negotiate(const std::string &offers, const Params &config, Params &params, std::string &response)
+{
+    // the client can list several offers in the order of preference, the first acceptable one is taken
+    for(auto &offer: StringUtil::Split(offers, ','))
+    {
+        auto list = StringUtil::Split(offer, ';');
+        if(list.empty())
+        {
+            continue;
+        }
+
+        std::string name = list[0];
+        StringUtil::Trim(name);
+        StringUtil::ToLower(name);
+        if(name != EXTENSION_NAME)
+        {
+            continue;
+        }
+
+        Params agreed = config;
+        bool valid = true;
+        bool serverBits = false, clientBits = false;
+        bool serverTakeover = false, clientTakeover = false;
+        int clientMaxWindowBits = MAX_WINDOW_BITS;
+
+        for(size_t i = 1;i < list.size() && valid;i ++)
+        {
+            std::string param = list[i];
+            std::string value;
+            auto pos = param.find('=');
+            if(pos != std::string::npos)
+            {
+                value = param.substr(pos + 1);
+                param = param.substr(0, pos);
+                StringUtil::Trim(value, " \t\"");
+            }
+            StringUtil::Trim(param);
+            StringUtil::ToLower(param);
+
+            int bits = MAX_WINDOW_BITS;
+            if(!value.empty() && (StringUtil::String2int(value, bits) == false || bits < MIN_WINDOW_BITS || bits > MAX_WINDOW_BITS))
+            {
+                valid = false;
+                break;
+            }
+
+            // each parameter is allowed once
+            switch(_(param.c_str()))
+            {
+                case _("server_no_context_takeover"):
+                    valid = !serverTakeover && value.empty();
+                    serverTakeover = true;
+                    agreed.serverNoContextTakeover = true;
+                    break;
+                case _("client_no_context_takeover"):
+                    valid = !clientTakeover && value.empty();
+                    clientTakeover = true;
+                    agreed.clientNoContextTakeover = true;
+                    break;
+                case _("server_max_window_bits"):
+                    valid = !serverBits && !value.empty();
+                    serverBits = true;
+                    agreed.serverMaxWindowBits = std::min(config.serverMaxWindowBits, bits);
+                    break;
+                case _("client_max_window_bits"):
+                    valid = !clientBits;
+                    clientBits = true;
+                    clientMaxWindowBits = bits;
+                    break;
+                default:
+                    valid = false;
+                    break;
+            }
+        }
+
+        if(valid == false || agreed.serverMaxWindowBits < MIN_DEFLATE_WINDOW_BITS)
+        {
+            continue;
+        }
+
+        // the client's window can be limited only if the client supports it
+        agreed.clientMaxWindowBits = clientBits ? std::min(config.clientMaxWindowBits, clientMaxWindowBits) : MAX_WINDOW_BITS;
+
+        // the server can use a smaller window without notice but the parameter is answered only if it's offered
+        response = EXTENSION_NAME;
+        if(agreed.serverNoContextTakeover)
+        {
+            response += "; server_no_context_takeover";
+        }
+        if(agreed.clientNoContextTakeover)
+        {
+            response += "; client_no_context_takeover";
+        }
+        if(serverBits)
+        {
+            response += "; server_max_window_bits=" + std::to_string(agreed.serverMaxWindowBits);
+        }
+        if(clientBits && agreed.clientMaxWindowBits < MAX_WINDOW_BITS)
+        {
+            response += "; client_max_window_bits=" + std::to_string(agreed.clientMaxWindowBits);
+        }
+
+        params = agreed;
+        return true;
+    }
+
+    return false;
+}
+
+bool WebSocketDeflate::ParseResponse(const std::string &extension, Params &params)
+{
+    auto list = StringUtil::Split(extension, ';');
+    if(list.empty())
+    {
+        return false;
+    }
+
+    std::string name = list[0];
+    StringUtil::Trim(name);
+    StringUtil::ToLower(name);
+    if(name != EXTENSION_NAME)
+    {
+        return false;
+    }
+
+    Params agreed;
+    for(size_t i = 1;i < list.size();i ++)
+    {
+        std::string param = list[i];
+        std::string value;
+        auto pos = param.find('=');
+        if(pos != std::string::npos)
+        {
+            value = param.substr(pos + 1);
+            param = param.substr(0, pos);
+            StringUtil::Trim(value, " \t\"");
+        }
+        StringUtil::Trim(param);
+        StringUtil::ToLower(param);
+
+        int bits = MAX_WINDOW_BITS;
+        switch(_(param.c_str()))
+        {
+            case _("server_no_context_takeover"):
+                agreed.serverNoContextTakeover = true;
+                break;
+            case _("client_no_context_takeover"):
+                agreed.clientNoContextTakeover = true;
+                break;
+            case _("server_max_window_bits"):
+                if(StringUtil::String2int(value, bits) == false || bits < MIN_WINDOW_BITS || bits > MAX_WINDOW_BITS)
+                {
+                    return false;
+                }
+                agreed.serverMaxWindowBits = bits;
+                break;
+            case _("client_max_window_bits"):
+                if(StringUtil::String2int(value, bits) == false || bits < MIN_DEFLATE_WINDOW_BITS || bits > MAX_WINDOW_BITS)
+                {
+                    return false;
+                }
+                agreed.clientMaxWindowBits = bits;
+                break;
+            default:
+                return false;
+        }
+    }
+
+    params = agreed;
+    return true;
+}
+
+std::string WebSocketDeflate::GetOffer()
+{
+    return std::string(EXTENSION_NAME) + "; client_max_window_bits";
+}
+
+size_t WebSocketDeflate::EstimateMemory(const Params &params)
+{
+    // the sizes of the zlib state for the given window, see zconf.h
+    int deflateBits = std::max(std::max(params.serverMaxWindowBits, params.clientMaxWindowBits), MIN_DEFLATE_WINDOW_BITS);
+    int inflateBits = std::max(params.serverMaxWindowBits, params.clientMaxWindowBits);
+
+    return (1 << (deflateBits + 2)) + (1 << (MEM_LEVEL + 9)) + DEFLATE_STATE_SIZE +
+           (1 << inflateBits) + INFLATE_STATE_SIZE;
+}
+
+#endif
@@ -1,29 +1,50 @@
 #ifdef WITH_WEBSOCKET
 
 #include <cstring>
+#include <climits>
+#include <chrono>
+#include <sys/uio.h>
 #include "CommunicationTcpServer.h"
 #include "CommunicationSslServer.h"
 #include "LogWriter.h"
 #include "FileSystem.h"
+#include "ClockCache.h"
 #include "Lock.h"
 #include "Data.h"
 #include "common_ws.h"
 #include "defines_webcpp.h"
 #include "WebSocketServer.h"
+#include "HttpServer.h"
 #include "IHttp.h"
 
+#define MIN_COMPACT_SIZE (64_Kb)
+#define MAX_IDLE_BUFFER_SIZE (1_Mb)
+#define MIN_CHUNK_SIZE (16_Kb)
+#define MAX_CONTROL_FRAME_SIZE 125
+#define KEEPALIVE_TICK 250 // msec.
+#define WS_KEY_SIZE 24
+#define WS_ACCEPT_SIZE 28
+#define SHA1_DIGEST_SIZE 20
 
 using namespace WebCpp;
 
 WebSocketServer::WebSocketServer():
-    m_config(WebCpp::HttpConfig::Instance())
+    m_config(WebCpp::HttpConfig::Instance()),
+    m_reapedCount(0)
 {
 
 }
 
 WebSocketServer::~WebSocketServer()
 {
-
+    StopRequestThread();
+    StopWorkers();
+    Detach();
+    if(m_clockStarted)
+    {
+        ClockCache::Stop();
+        m_clockStarted = false;
+    }
 }
 
 bool WebSocketServer::Init()
@@ -70,17 +91,80 @@ bool WebSocketServer::Init()
     m_server->SetDataReadyCallback(f2);
     auto f3 = std::bind(&WebSocketServer::OnClosed, this, std::placeholders::_1);
     m_server->SetCloseConnectionCallback(f3);
+    auto f4 = std::bind(&WebSocketServer::OnWriteReady, this, std::placeholders::_1);
+    m_server->SetWriteReadyCallback(f4);
+
+    return Start();
+}
+
+// the connections come upgraded from the HTTP server, its socket and poll thread are shared
+bool WebSocketServer::Init(HttpServer &server)
+{
+    ClearError();
+
+    m_server = server.GetCommunicationServer();
+    if(m_server == nullptr)
+    {
+        SetLastError("http server isn't initialized");
+        LOG(GetLastError(), LogWriter::LogType::Error);
+        return false;
+    }
+
+    m_attached = true;
+    m_protocol = (m_config.GetHttpProtocol() == Http::Protocol::HTTPS ? Http::Protocol::WSS : Http::Protocol::WS);
+    // the HTTP server has to outlive this one, it's detached on closing
+    m_httpServer = &server;
+    server.SetWebSocketServer(this);
 
-    if(StartRequestThread() == false)
+    LOG(ToString(), LogWriter::LogType::Info);
+
+    return Start();
+}
+
+bool WebSocketServer::Start()
+{
+    // the same ping frame is sent to all the connections
+    ResponseWebSocket ping(-1);
+    ping.SetMessageType(MessageType::Ping);
+    m_pingFrame = std::make_shared<const ByteArray>(ping.ToByteArray());
+    m_keepAlive = (m_config.GetWsPingInterval() > 0 || m_config.GetWsHandshakeTimeout() > 0);
+
+    // the constant part of the handshake response is built once
+    m_handshakeHeader = std::string("HTTP/1.1 101 ") + Response::ResponseCode2String(101) + "\r\n" +
+                        "Server: " + m_config.GetServerName() + "\r\n" +
+                        "Upgrade: websocket\r\n" +
+                        "Connection: Upgrade\r\n" +
+                        "Sec-WebSocket-Version: " WS_VERSION "\r\n" +
+                        "Sec-WebSocket-Accept: ";
+
+    if(StartWorkers() == false || StartRequestThread() == false)
     {
         return false;
     }
 
+    m_clockStarted = ClockCache::Run();
+
     return true;
 }
 
+// the HTTP server stops forwarding the data and closes the upgraded connections
+void WebSocketServer::Detach()
+{
+    if(m_httpServer != nullptr)
+    {
+        m_httpServer->SetWebSocketServer(nullptr);
+        m_httpServer = nullptr;
+    }
+}
+
 bool WebSocketServer::Run()
 {
+    if(m_attached)
+    {
+        m_running = true;
+        return m_running;
+    }
+
     if(!m_server->Connect())
     {
         return false;
@@ -97,8 +181,18 @@ bool WebSocketServer::Run()
 
 bool WebSocketServer::Close(bool wait)
 {
-    m_server->Close(wait);
+    if(m_attached == false)
+    {
+        m_server->Close(wait);
+    }
     StopRequestThread();
+    StopWorkers();
+    Detach();
+    if(m_clockStarted)
+    {
+        ClockCache::Stop();
+        m_clockStarted = false;
+    }
     return true;
 }
 
@@ -142,11 +236,62 @@ void WebSocketServer::OnMessage(const std::string &path, const std::function<boo
     }
 }
 
+void WebSocketServer::OnMessageChunk(const std::string &path, const std::function<bool(const Request &, ResponseWebSocket &, const ByteArray &, bool)> &func)
+{
+    RouteWebSocket *route = GetRoute(path);
+    if(route == nullptr)
+    {
+        RouteWebSocket route(path);
+        LOG("register route: " + route.ToString(), LogWriter::LogType::Info);
+        route.SetFunctionChunk(func);
+        m_routes.push_back(std::move(route));
+    }
+    else
+    {
+        route->SetFunctionChunk(func);
+        LOG("register chunk function for route: " + route->ToString(), LogWriter::LogType::Info);
+    }
+}
+
+void WebSocketServer::OnMessageView(const std::string &path, const std::function<bool (const Request &, ResponseWebSocket &, const uint8_t *, size_t)> &func)
+{
+    RouteWebSocket *route = GetRoute(path);
+    if(route == nullptr)
+    {
+        RouteWebSocket route(path);
+        LOG("register route: " + route.ToString(), LogWriter::LogType::Info);
+        route.SetFunctionView(func);
+        m_routes.push_back(std::move(route));
+    }
+    else
+    {
+        route->SetFunctionView(func);
+        LOG("register view function for route: " + route->ToString(), LogWriter::LogType::Info);
+    }
+}
+
+void WebSocketServer::SetMaxMessageSize(const std::string &path, size_t size)
+{
+    RouteWebSocket *route = GetRoute(path);
+    if(route == nullptr)
+    {
+        RouteWebSocket route(path);
+        LOG("register route: " + route.ToString(), LogWriter::LogType::Info);
+        route.SetMaxMessageSize(size);
+        m_routes.push_back(std::move(route));
+    }
+    else
+    {
+        route->SetMaxMessageSize(size);
+    }
+}
+
 bool WebSocketServer::SendResponse(const ResponseWebSocket &response)
 {
-    if(!response.IsEmpty())
+    if(!response.IsEmpty() && QueueResponse(response))
     {
-        return response.Send(m_server.get());
+        SendSignal();
+        return true;
     }
 
     return false;
@@ -162,6 +307,84 @@ std::string WebSocketServer::ToString() const
     return m_config.ToString();
 }
 
+bool WebSocketServer::Subscribe(int connID, const std::string &topic)
+{
+    Lock lock(m_outputMutex);
+
+    if(connID < 0 || static_cast<size_t>(connID) >= m_outputs.size() || m_outputs[connID].open == false)
+    {
+        return false;
+    }
+
+    m_outputs[connID].topics.insert(topic);
+    m_topics[topic].insert(connID);
+
+    return true;
+}
+
+bool WebSocketServer::Unsubscribe(int connID, const std::string &topic)
+{
+    Lock lock(m_outputMutex);
+
+    auto it = m_topics.find(topic);
+    if(it == m_topics.end() || it->second.erase(connID) == 0)
+    {
+        return false;
+    }
+
+    if(it->second.empty())
+    {
+        m_topics.erase(it);
+    }
+    m_outputs[connID].topics.erase(topic);
+
+    return true;
+}
+
+size_t WebSocketServer::Broadcast(const std::string &topic, const ByteArray &data, MessageType type)
+{
+    size_t count = 0;
+
+    {
+        Lock lock(m_outputMutex);
+
+        auto it = m_topics.find(topic);
+        if(it == m_topics.end())
+        {
+            return 0;
+        }
+
+        // the frame is encoded once, all the subscribers share the same buffer
+        ResponseWebSocket response(-1);
+        response.WriteBinary(data);
+        response.SetMessageType(type);
+        Frame frame = std::make_shared<const ByteArray>(response.ToByteArray());
+
+        for(int connID: it->second)
+        {
+            if(QueueFrame(connID, frame))
+            {
+                count ++;
+            }
+        }
+    }
+
+    SendSignal();
+
+    return count;
+}
+
+size_t WebSocketServer::Broadcast(const std::string &topic, const std::string &data, MessageType type)
+{
+    return Broadcast(topic, ByteArray(data.begin(), data.end()), type);
+}
+
+size_t WebSocketServer::GetReapedCount() const
+{
+    // the counter is atomic since it's written by the request thread and read from any thread
+    return m_reapedCount;
+}
+
 void WebSocketServer::OnConnected(int connID, const std::string &remote)
 {
     LOG(std::string("client connected: #") + std::to_string(connID) + ", " + remote, LogWriter::LogType::Access);
@@ -177,9 +400,33 @@ void WebSocketServer::OnDataReady(int connID, ByteArray &data)
 void WebSocketServer::OnClosed(int connID)
 {
     LOG(std::string("websocket connection closed: #") + std::to_string(connID), LogWriter::LogType::Access);
+    CloseOutput(connID);
     RemoveFromQueue(connID);
 }
 
+// the socket takes data again, the rest of the output is written by the request thread
+void WebSocketServer::OnWriteReady(int connID)
+{
+    {
+        Lock lock(m_outputMutex);
+
+        if(connID < 0 || static_cast<size_t>(connID) >= m_outputs.size())
+        {
+            return;
+        }
+
+        auto &output = m_outputs[connID];
+        output.blocked = false;
+        if(output.dirty == false)
+        {
+            output.dirty = true;
+            m_outputDirty.push_back(connID);
+        }
+    }
+
+    SendSignal();
+}
+
 bool WebSocketServer::StartRequestThread()
 {
     auto f = std::bind(&WebSocketServer::RequestThread, this, std::placeholders::_1);
@@ -206,15 +453,92 @@ bool WebSocketServer::StopRequestThread()
     return true;
 }
 
+bool WebSocketServer::StartWorkers()
+{
+    int count = std::max(m_config.GetWsWorkerThreads(), 1);
+
+    for(int i = 0;i < count;i ++)
+    {
+        std::unique_ptr<Worker> worker(new Worker());
+        auto f = std::bind(&WebSocketServer::WorkerThread, this, std::placeholders::_1, worker.get());
+        worker->thread.SetFunction(f);
+        if(worker->thread.Start() == false)
+        {
+            SetLastError("failed to run worker thread: " + worker->thread.GetLastError());
+            LOG(GetLastError(), LogWriter::LogType::Error);
+            return false;
+        }
+        m_workers.push_back(std::move(worker));
+    }
+
+    return true;
+}
+
+void WebSocketServer::StopWorkers()
+{
+    for(auto &worker: m_workers)
+    {
+        if(worker->thread.IsRunning())
+        {
+            worker->thread.StopNoWait();
+            {
+                Lock lock(worker->mutex);
+                worker->signal.Fire();
+            }
+            worker->thread.Wait();
+        }
+    }
+    m_workers.clear();
+}
+
+void *WebSocketServer::WorkerThread(bool &running, Worker *worker)
+{
+    while(running)
+    {
+        RequestData *requestData = nullptr;
+        {
+            Lock lock(worker->mutex);
+            while(worker->queue.empty() && running)
+            {
+                worker->signal.Wait(worker->mutex);
+            }
+            if(worker->queue.empty())
+            {
+                break;
+            }
+            requestData = worker->queue.front();
+            worker->queue.pop_front();
+        }
+
+        Dispatch(*requestData);
+        FlushOutput();
+    }
+
+    return nullptr;
+}
+
 void *WebSocketServer::RequestThread(bool &running)
 {
+    // the thread wakes up by the timer to check the connections if the keep-alive is enabled
+    // and to send the delayed output
+    uint32_t timeout = m_keepAlive ? KEEPALIVE_TICK : 0;
+    if(m_config.GetWsSendDelay() > 0)
+    {
+        timeout = (timeout == 0 ? m_config.GetWsSendDelay() : std::min(timeout, static_cast<uint32_t>(m_config.GetWsSendDelay())));
+    }
+
     while(m_requestThread.IsRunning())
     {
-        WaitForSignal();
+        WaitForSignal(timeout);
         if(CheckData())
         {
             ProcessRequests();
         }
+        if(m_keepAlive)
+        {
+            CheckAlive();
+        }
+        FlushOutput();
     }
 
     return nullptr;
@@ -223,75 +547,199 @@ void *WebSocketServer::RequestThread(bool &running)
 void WebSocketServer::SendSignal()
 {
     Lock lock(m_signalMutex);
+    m_signalPending = true;
     m_signalCondition.Fire();
 }
 
-void WebSocketServer::WaitForSignal()
+void WebSocketServer::WaitForSignal(uint32_t timeout)
 {
     Lock lock(m_signalMutex);
-    m_signalCondition.Wait(m_signalMutex);
+    // the data could arrive while the previous portion was processed, don't lose the wakeup
+    while(m_signalPending == false && m_requestThread.IsRunning())
+    {
+        if(timeout == 0)
+        {
+            m_signalCondition.Wait(m_signalMutex);
+        }
+        else if(m_signalCondition.Wait(m_signalMutex, timeout) == false)
+        {
+            break;
+        }
+    }
+    m_signalPending = false;
 }
 
-void WebSocketServer::PutToQueue(int connID, ByteArray &data)
+void WebSocketServer::PutToQueue(int connID, const ByteArray &data)
 {
     Lock lock(m_queueMutex);
 
-    for(auto &req: m_requestQueue)
+    auto requestData = GetConnection(connID);
+    if(requestData != nullptr)
+    {
+        requestData->input.insert(requestData->input.end(), data.begin(), data.end());
+        // any data from the peer proves it's alive, not only the pong
+        requestData->lastActivity = Now();
+        requestData->pingPending = false;
+        SetDirty(*requestData);
+    }
+}
+
+bool WebSocketServer::CanUpgrade(Request &request)
+{
+    // the routes are matched by the websocket method
+    request.SetMethod(Http::Method::WEBSOCKET);
+    bool retval = false;
+    for(auto &route: m_routes)
     {
-        if(req.connID == connID)
+        if(route.IsMatch(request))
         {
-            req.data.insert(req.data.end(), data.begin(), data.end());
+            retval = true;
             break;
         }
     }
+    request.SetMethod(Http::Method::GET);
+
+    return retval;
+}
+
+// the parsed handshake and the data after it are taken over, the handshake is answered by the request thread
+void WebSocketServer::Upgrade(Request &request, ByteArray &data)
+{
+    int connID = request.GetConnectionID();
+    CloseOutput(connID);
+    RemoveFromQueue(connID);
+    InitConnection(connID, request.GetRemote());
+
+    {
+        Lock lock(m_queueMutex);
+        auto requestData = GetConnection(connID);
+        if(requestData == nullptr)
+        {
+            return;
+        }
+
+        requestData->request = std::move(request);
+        requestData->request.SetMethod(Http::Method::WEBSOCKET);
+        requestData->request.SetSession(nullptr);
+        requestData->data.swap(data);
+        requestData->readyForDispatch = true;
+        m_ready.push_back(connID);
+    }
+
+    SendSignal();
+}
+
+WebSocketServer::RequestData* WebSocketServer::GetConnection(int connID)
+{
+    if(connID < 0 || static_cast<size_t>(connID) >= m_connections.size())
+    {
+        return nullptr;
+    }
+
+    return m_connections[connID].get();
+}
+
+void WebSocketServer::SetDirty(RequestData &requestData)
+{
+    if(requestData.dirty == false)
+    {
+        requestData.dirty = true;
+        m_dirty.push_back(requestData.connID);
+    }
 }
 
 bool WebSocketServer::IsQueueEmpty()
 {
     Lock lock(m_queueMutex);
-    return m_requestQueue.empty();
+    return m_connectionCount == 0;
 }
 
 void WebSocketServer::InitConnection(int connID, const std::string &remote)
 {
     Lock lock(m_queueMutex);
 
-    for(auto &req: m_requestQueue)
+    if(connID < 0 || GetConnection(connID) != nullptr)
     {
-        if(req.connID == connID)
-        {
-            return;
-        }
+        return;
+    }
+
+    // the connection IDs are the indexes in the socket pool so the slot array stays compact
+    if(static_cast<size_t>(connID) >= m_connections.size())
+    {
+        m_connections.resize(connID + 1);
     }
+    auto requestData = new RequestData(connID, remote);
+    m_connections[connID].reset(requestData);
+    requestData->lastActivity = Now();
+    requestData->serial = ++ m_serial;
+    m_connectionCount ++;
 
-    m_requestQueue.push_back(RequestData(connID, remote));
+    if(m_keepAlive)
+    {
+        m_aliveTimers.push({ GetAliveDeadline(*requestData), connID, requestData->serial });
+    }
 }
 
 bool WebSocketServer::CheckData()
 {
-    bool retval = false;
     Lock lock(m_queueMutex);
 
-    for(RequestData& requestData: m_requestQueue)
+    // only the connections that received data since the last pass are checked
+    std::vector<int> dirty;
+    dirty.swap(m_dirty);
+
+    for(int connID: dirty)
     {
-        if(requestData.readyForDispatch == false)
+        auto requestData = GetConnection(connID);
+        if(requestData == nullptr || requestData->dirty == false)
         {
-            if(requestData.handshake == false)
-            {
-                retval |= CheckWsHeader(requestData);
-            }
-            else
+            continue;
+        }
+
+        // the data of the connection that is dispatched now is checked when the worker is done
+        requestData->dirty = false;
+        if(requestData->readyForDispatch)
+        {
+            continue;
+        }
+
+        bool ready = false;
+        if(requestData->handshake == false)
+        {
+            TakeInput(*requestData);
+            ready = CheckWsHeader(*requestData);
+        }
+        else
+        {
+            CompactBuffer(*requestData);
+            TakeInput(*requestData);
+            while(CheckWsFrame(*requestData))
             {
-                bool frameParsed;
-                while((frameParsed = CheckWsFrame(requestData)))
-                {
-                    retval |= frameParsed;
-                }
+                ready = true;
             }
+            ready = ready || requestData->closing;
+        }
+
+        if(ready)
+        {
+            m_ready.push_back(connID);
         }
     }
 
-    return retval;
+    return (m_ready.empty() == false);
+}
+
+void WebSocketServer::TakeInput(RequestData &requestData)
+{
+    if(requestData.data.empty())
+    {
+        requestData.data.swap(requestData.input);
+    }
+    else
+    {
+        requestData.data.insert(requestData.data.end(), requestData.input.begin(), requestData.input.end());
+    }
+    requestData.input.clear();
 }
 
 bool WebSocketServer::CheckWsHeader(RequestData& requestData)
@@ -316,81 +764,887 @@ bool WebSocketServer::CheckWsHeader(RequestData& requestData)
 
 bool WebSocketServer::CheckWsFrame(RequestData& requestData)
 {
-    bool retval = false;
-    Lock lock(m_requestMutex);
-
-    RequestWebSocket request;
-    if(request.Parse(requestData.data))
+    if(requestData.closing)
     {
-        size_t size = request.GetSize();
-        requestData.data.erase(requestData.data.begin(), requestData.data.begin() + size);
-        requestData.requestList.push_back(std::move(request));
-        requestData.readyForDispatch = true;
-        requestData.handshake = true;
-        retval = true;
+        return false;
     }
 
-    return retval;
+    // only the streaming handler takes the large frames by chunks as they arrive, for the others
+    // the frame is taken whole so a single frame message is never copied before the view handler
+    size_t minChunk = requestData.streaming ? MIN_CHUNK_SIZE : SIZE_MAX;
+    RequestWebSocket request;
+    if(requestData.framePending)
+    {
+        request = requestData.frame;
+        if(request.ParseNext(requestData.data, requestData.offset, minChunk) == false)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        if(request.ParseHeader(requestData.data, requestData.offset) == false)
+        {
+            return false;
+        }
+        // the message is checked once by the frame header, so it's rejected before the payload is received
+        if(requestData.frameChecked == false)
+        {
+            if(CheckWsMessage(requestData, request) == false)
+            {
+                return false;
+            }
+            requestData.frameChecked = true;
+        }
+        if(request.Parse(requestData.data, requestData.offset, minChunk) == false)
+        {
+            return false;
+        }
+        requestData.frameChecked = false;
+    }
+
+    requestData.offset += request.GetSize();
+    requestData.framePending = (request.IsComplete() == false);
+    if(requestData.framePending)
+    {
+        requestData.frame = request;
+    }
+    requestData.requestList.push_back(std::move(request));
+    requestData.readyForDispatch = true;
+    requestData.handshake = true;
+
+    return true;
+}
+
+bool WebSocketServer::CheckWsMessage(RequestData &requestData, const RequestWebSocket &frame)
+{
+    bool compressed = frame.IsCompressed();
+#ifdef WITH_ZLIB
+    // RSV1 is allowed only with the negotiated extension and only for the first fragment, RFC 7692, 6.1
+    compressed = compressed && (requestData.deflate == nullptr || frame.GetType() == MessageType::Undefined);
+#endif
+    if(compressed)
+    {
+        SetClosing(requestData, CloseCode::ProtocolError);
+        return false;
+    }
+
+    switch(frame.GetType())
+    {
+        case MessageType::Undefined:
+            // the continuation is accepted only inside of a fragmented message
+            if(requestData.messageActive == false)
+            {
+                SetClosing(requestData, CloseCode::ProtocolError);
+                return false;
+            }
+            requestData.messageLength += frame.GetLength();
+            requestData.messageActive = (frame.IsFinal() == false);
+            break;
+        case MessageType::Text:
+        case MessageType::Binary:
+            if(requestData.messageActive)
+            {
+                SetClosing(requestData, CloseCode::ProtocolError);
+                return false;
+            }
+            requestData.messageLength = frame.GetLength();
+            requestData.messageActive = (frame.IsFinal() == false);
+            break;
+        case MessageType::Close:
+        case MessageType::Ping:
+        case MessageType::Pong:
+            // the control frames can be injected between the fragments
+            if(frame.IsFinal() == false || frame.IsCompressed() || frame.GetLength() > MAX_CONTROL_FRAME_SIZE)
+            {
+                SetClosing(requestData, CloseCode::ProtocolError);
+                return false;
+            }
+            return true;
+        default:
+            SetClosing(requestData, CloseCode::ProtocolError);
+            return false;
+    }
+
+    // the size is checked by the header so the message is rejected before its payload is received
+    if(requestData.messageLength > requestData.maxMessageSize)
+    {
+        SetClosing(requestData, CloseCode::MessageTooBig);
+        return false;
+    }
+
+    return true;
 }
 
+void WebSocketServer::SetClosing(RequestData &requestData, CloseCode code)
+{
+    LOG("websocket protocol error, code " + std::to_string(static_cast<int>(code)) + ": #" + std::to_string(requestData.connID), LogWriter::LogType::Error);
+    requestData.closing = true;
+    requestData.closeCode = code;
+    if(requestData.dispatching == false)
+    {
+        requestData.readyForDispatch = true;
+    }
+}
+
+void WebSocketServer::InitMessageLimits(RequestData &requestData)
+{
+    requestData.maxMessageSize = m_config.GetWsMaxMessageSize();
+    requestData.streaming = false;
+
+    for(auto &route: m_routes)
+    {
+        if(route.IsMatch(requestData.request))
+        {
+            if(route.GetMaxMessageSize() > 0)
+            {
+                requestData.maxMessageSize = route.GetMaxMessageSize();
+            }
+            requestData.streaming = (route.GetFunctionChunk() != nullptr);
+            requestData.view = (route.GetFunctionView() != nullptr);
+            break;
+        }
+    }
+}
+
+void WebSocketServer::CompactBuffer(RequestData &requestData)
+{
+    // the parsed frames point into the buffer, so it's compacted only when all of them are dispatched
+    if(requestData.requestList.empty() == false)
+    {
+        return;
+    }
+
+    if(requestData.offset >= requestData.data.size())
+    {
+        requestData.data.clear();
+        if(requestData.data.capacity() > MAX_IDLE_BUFFER_SIZE)
+        {
+            ByteArray().swap(requestData.data);
+        }
+        requestData.offset = 0;
+    }
+    else if(requestData.offset >= MIN_COMPACT_SIZE && requestData.offset >= requestData.data.size() / 2)
+    {
+        requestData.data.erase(requestData.data.begin(), requestData.data.begin() + requestData.offset);
+        requestData.offset = 0;
+    }
+}
+
+// the ready connections are passed to the workers, a connection always goes to the same one
 void WebSocketServer::ProcessRequests()
 {
-    Lock lock(m_queueMutex);
+    std::vector<std::vector<RequestData*>> batches(m_workers.size());
 
-    for(auto &entry: m_requestQueue)
     {
-        if(entry.readyForDispatch)
+        Lock lock(m_queueMutex);
+
+        for(int connID: m_ready)
         {
-            if(entry.handshake == false)
+            auto entry = GetConnection(connID);
+            if(entry == nullptr || entry->readyForDispatch == false || entry->dispatching)
             {
-                if(ProcessRequest(entry.request))
-                {
-                    entry.handshake = true;
-                    entry.readyForDispatch = false;
-                }
+                continue;
             }
-            else
+
+            entry->dispatching = true;
+            batches[connID % m_workers.size()].push_back(entry);
+        }
+
+        m_ready.clear();
+    }
+
+    for(size_t i = 0;i < batches.size();i ++)
+    {
+        if(batches[i].empty() == false)
+        {
+            auto &worker = m_workers[i];
+            Lock lock(worker->mutex);
+            worker->queue.insert(worker->queue.end(), batches[i].begin(), batches[i].end());
+            worker->signal.Fire();
+        }
+    }
+}
+
+// the handlers run without the queue lock, the connection's data is not touched by the other threads meanwhile
+void WebSocketServer::Dispatch(RequestData &requestData)
+{
+    int connID = requestData.connID;
+    bool handshake = false;
+    bool rejected = false;
+
+    if(requestData.handshake == false)
+    {
+        handshake = ProcessRequest(requestData);
+        rejected = !handshake;
+        if(handshake)
+        {
+            InitMessageLimits(requestData);
+        }
+    }
+    else
+    {
+        for(auto &frame: requestData.requestList)
+        {
+            if(DispatchFrame(requestData, frame) == false)
+            {
+                break;
+            }
+        }
+        requestData.requestList.clear();
+        if(requestData.payload.capacity() > MAX_IDLE_BUFFER_SIZE)
+        {
+            ByteArray().swap(requestData.payload);
+        }
+    }
+
+    bool closing = requestData.closing;
+    CloseCode code = requestData.closeCode;
+    bool pending = false;
+
+    {
+        Lock lock(m_queueMutex);
+
+        requestData.dispatching = false;
+        requestData.readyForDispatch = false;
+        if(requestData.removed)
+        {
+            // the connection is closed while dispatched
+            for(auto it = m_retired.begin();it != m_retired.end();++ it)
             {
-                Lock lock(m_requestMutex);
-                if(entry.requestList.size() > 0)
+                if(it->get() == &requestData)
                 {
-                    auto it = entry.requestList.begin();
-                    while (it != entry.requestList.end())
+#ifdef WITH_ZLIB
+                    if(requestData.deflate != nullptr)
                     {
-                        if(it->IsFinal())
-                        {
-                            ProcessWsRequest(entry.request, *it);
-                            it = entry.requestList.erase(it);
-                        }
-                        else
-                        {
-                            ++it;
-                        }
+                        m_deflateMemory -= requestData.deflate->GetMemoryUsage();
                     }
-
-                    entry.readyForDispatch = false;
+#endif
+                    m_retired.erase(it);
+                    break;
                 }
             }
+            return;
+        }
+
+        if(handshake)
+        {
+            OpenOutput(connID, &requestData);
+            requestData.handshake = true;
+        }
+
+        // the data received meanwhile or came along with the handshake
+        if(closing == false && rejected == false && (requestData.input.empty() == false || requestData.offset < requestData.data.size()))
+        {
+            SetDirty(requestData);
+            pending = true;
+        }
+    }
+
+    // closing calls OnClosed that takes the queue lock again
+    if(closing)
+    {
+        CloseConnection(connID, code);
+    }
+    else if(rejected)
+    {
+        m_server->CloseConnection(connID);
+    }
+
+    if(pending)
+    {
+        SendSignal();
+    }
+}
+
+bool WebSocketServer::DispatchFrame(RequestData &requestData, const RequestWebSocket &frame)
+{
+    const uint8_t *payload = requestData.data.data() + frame.GetPayloadOffset();
+    size_t size = frame.GetPayloadSize();
+    MessageType type = frame.GetType();
+
+    switch(type)
+    {
+        case MessageType::Close:
+        case MessageType::Ping:
+        case MessageType::Pong:
+            return ProcessWsRequest(requestData, type, payload, size);
+        case MessageType::Text:
+        case MessageType::Binary:
+            if(frame.IsFirst())
+            {
+                requestData.messageType = type;
+                requestData.messageCompressed = frame.IsCompressed();
+                requestData.messageSize = 0;
+            }
+            break;
+        default:
+            break;
+    }
+
+    bool last = frame.IsFinal() && frame.IsComplete();
+    requestData.payload.clear();
+
+    // the streaming handler gets the payload as it arrives
+    if(requestData.streaming)
+    {
+        if(ReadPayload(requestData, payload, size, requestData.payload, last) == false)
+        {
+            return false;
+        }
+        requestData.messageSize += requestData.payload.size();
+        return ProcessWsChunk(requestData, requestData.payload, last);
+    }
+
+    // the single frame is passed to the view handler right from the input buffer
+    if(last && requestData.message.empty() && requestData.view && requestData.messageCompressed == false)
+    {
+        return ProcessWsRequest(requestData, requestData.messageType, payload, size);
+    }
+
+    // otherwise the fragments are collected until the message is complete
+    if(last && requestData.message.empty())
+    {
+        if(ReadPayload(requestData, payload, size, requestData.payload, true) == false)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        requestData.message.insert(requestData.message.end(), payload, payload + size);
+        if(last == false)
+        {
+            return true;
+        }
+
+        bool retval = ReadPayload(requestData, requestData.message.data(), requestData.message.size(), requestData.payload, true);
+        requestData.message.clear();
+        if(requestData.message.capacity() > MAX_IDLE_BUFFER_SIZE)
+        {
+            ByteArray().swap(requestData.message);
+        }
+        if(retval == false)
+        {
+            return false;
+        }
+    }
+
+    return ProcessWsRequest(requestData, requestData.messageType, requestData.payload);
+}
+
+bool WebSocketServer::ReadPayload(RequestData &requestData, const uint8_t *data, size_t size, ByteArray &out, bool last)
+{
+    if(requestData.messageCompressed == false)
+    {
+        out.insert(out.end(), data, data + size);
+        return true;
+    }
+
+#ifdef WITH_ZLIB
+    // the inflated size is limited as well as the received one
+    size_t limit = requestData.maxMessageSize - std::min(requestData.messageSize, requestData.maxMessageSize);
+    if(requestData.deflate != nullptr && requestData.deflate->Decompress(data, size, out, limit, last))
+    {
+        return true;
+    }
+
+    SetClosing(requestData, out.size() > limit ? CloseCode::MessageTooBig : CloseCode::InvalidData);
+#else
+    (void)last;
+    SetClosing(requestData, CloseCode::ProtocolError);
+#endif
+
+    return false;
+}
+
+void WebSocketServer::CloseConnection(int connID, CloseCode code)
+{
+    uint16_t value = static_cast<uint16_t>(code);
+    ByteArray data = { static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value & 0xFF) };
+
+    ResponseWebSocket response(connID);
+    response.WriteBinary(data);
+    response.SetMessageType(MessageType::Close);
+    Frame frame = std::make_shared<const ByteArray>(response.ToByteArray());
+
+    // the queued frames go before the close frame
+    std::deque<Frame> frames;
+    size_t offset = 0;
+    {
+        Lock lock(m_outputMutex);
+        if(static_cast<size_t>(connID) < m_outputs.size())
+        {
+            auto &output = m_outputs[connID];
+            if(output.closing)
+            {
+                return;
+            }
+            output.open = false;
+            output.owner = nullptr;
+            output.frames.push_back(frame);
+            if(output.writing)
+            {
+                // the thread that writes the output now closes the connection after that
+                output.closing = true;
+                return;
+            }
+            frames.swap(output.frames);
+            offset = output.offset;
+            output.offset = 0;
+            output.size = 0;
+        }
+        else
+        {
+            frames.push_back(frame);
         }
     }
+
+    // the peer isn't waited for, what the socket doesn't take now is dropped
+    WriteFrames(connID, frames, offset);
+
+    m_server->CloseConnection(connID);
 }
 
 void WebSocketServer::RemoveFromQueue(int connID)
 {
     Lock lock(m_queueMutex);
 
-    for (auto it = m_requestQueue.begin(); it != m_requestQueue.end(); ++it)
+    if(GetConnection(connID) != nullptr)
+    {
+        // the slot is released at once so the ID can be reused, the worker deletes the entry it dispatches
+        if(m_connections[connID]->dispatching)
+        {
+            m_connections[connID]->removed = true;
+            m_retired.push_back(std::move(m_connections[connID]));
+        }
+        else
+        {
+#ifdef WITH_ZLIB
+            if(m_connections[connID]->deflate != nullptr)
+            {
+                m_deflateMemory -= m_connections[connID]->deflate->GetMemoryUsage();
+            }
+#endif
+            // the stale ID left in the dirty or the ready list is skipped since the slot is empty
+            m_connections[connID].reset();
+        }
+        m_connectionCount --;
+    }
+}
+
+void WebSocketServer::OpenOutput(int connID, const RequestData *owner)
+{
+    Lock lock(m_outputMutex);
+
+    if(static_cast<size_t>(connID) >= m_outputs.size())
+    {
+        m_outputs.resize(connID + 1);
+    }
+    auto &output = m_outputs[connID];
+    output.open = true;
+    output.owner = owner;
+    output.writing = false;
+    output.blocked = false;
+    output.closing = false;
+    output.offset = 0;
+    output.generation ++;
+}
+
+void WebSocketServer::CloseOutput(int connID)
+{
+    Lock lock(m_outputMutex);
+
+    if(connID < 0 || static_cast<size_t>(connID) >= m_outputs.size())
+    {
+        return;
+    }
+
+    auto &output = m_outputs[connID];
+    for(auto &topic: output.topics)
+    {
+        auto it = m_topics.find(topic);
+        if(it != m_topics.end())
+        {
+            it->second.erase(connID);
+            if(it->second.empty())
+            {
+                m_topics.erase(it);
+            }
+        }
+    }
+    output.topics.clear();
+    output.frames.clear();
+    output.size = 0;
+    output.offset = 0;
+    output.open = false;
+    output.owner = nullptr;
+    output.writing = false;
+    output.blocked = false;
+    output.closing = false;
+    output.generation ++;
+}
+
+bool WebSocketServer::QueueFrame(int connID, const Frame &frame)
+{
+    if(connID < 0 || static_cast<size_t>(connID) >= m_outputs.size() || m_outputs[connID].open == false)
+    {
+        return false;
+    }
+
+    auto &output = m_outputs[connID];
+    if(output.frames.empty())
+    {
+        output.since = Now();
+    }
+    output.frames.push_back(frame);
+    output.size += frame->size();
+    if(output.dirty == false)
+    {
+        output.dirty = true;
+        m_outputDirty.push_back(connID);
+    }
+
+    return true;
+}
+
+// the handler's response is queued to be sent with the other frames of the connection
+bool WebSocketServer::QueueResponse(const ResponseWebSocket &response, const RequestData *owner)
+{
+    Frame frame = std::make_shared<const ByteArray>(response.ToByteArray());
+    int connID = response.GetConnectionID();
+
+    {
+        Lock lock(m_outputMutex);
+        if(owner != nullptr)
+        {
+            // the handler's connection is closed, its response is dropped
+            if(connID < 0 || static_cast<size_t>(connID) >= m_outputs.size() || m_outputs[connID].owner != owner)
+            {
+                return false;
+            }
+            return QueueFrame(connID, frame);
+        }
+        if(QueueFrame(connID, frame))
+        {
+            return true;
+        }
+    }
+
+    // the output isn't open before the handshake is finished
+    return response.Send(m_server.get());
+}
+
+void WebSocketServer::FlushOutput()
+{
+    std::vector<int> pending;
+    uint64_t delay = std::max(m_config.GetWsSendDelay(), 0);
+    size_t batchSize = m_config.GetWsSendBatchSize();
+
+    {
+        Lock lock(m_outputMutex);
+
+        // in the throughput mode the small output is held until the batch is full or the delay is expired
+        uint64_t now = (delay > 0 ? Now() : 0);
+        std::vector<int> delayed;
+
+        for(int connID: m_outputDirty)
+        {
+            auto &output = m_outputs[connID];
+            // the connection written by another thread now is flushed by it again after that,
+            // the blocked one is flushed when its socket is writable
+            if(output.open == false || output.frames.empty() || output.writing || output.blocked)
+            {
+                output.dirty = false;
+                continue;
+            }
+
+            if(delay > 0 && output.size < batchSize && now - output.since < delay)
+            {
+                delayed.push_back(connID);
+                continue;
+            }
+
+            output.dirty = false;
+            output.writing = true;
+            pending.push_back(connID);
+        }
+        m_outputDirty.swap(delayed);
+    }
+
+    for(int connID: pending)
+    {
+        WriteOutput(connID);
+    }
+}
+
+// the frames are written while the socket takes them, the rest stays queued until the socket is writable,
+// the frames queued while writing go next to keep the order
+void WebSocketServer::WriteOutput(int connID)
+{
+    std::deque<Frame> frames;
+    size_t offset = 0;
+    uint64_t generation = 0;
+    bool blocked = false;
+    bool close = false;
+    bool error = false;
+
     {
-        if(it->connID == connID)
+        Lock lock(m_outputMutex);
+        auto &output = m_outputs[connID];
+        frames.swap(output.frames);
+        offset = output.offset;
+        generation = output.generation;
+        output.offset = 0;
+        output.size = 0;
+    }
+
+    while(frames.empty() == false)
+    {
+        size_t written = WriteFrames(connID, frames, offset);
+        error = (written == static_cast<size_t>(ERROR));
+        if(error == false)
+        {
+            written += offset;
+            while(frames.empty() == false && written >= frames.front()->size())
+            {
+                written -= frames.front()->size();
+                frames.pop_front();
+            }
+            offset = written;
+        }
+
+        Lock lock(m_outputMutex);
+        auto &output = m_outputs[connID];
+        if(output.generation != generation)
         {
-            m_requestQueue.erase(it);
+            // the connection is closed meanwhile
+            return;
+        }
+
+        // nothing can follow the partially written frame so the connection is closed on error,
+        // the closing connection isn't waited for
+        if(error || (frames.empty() == false && output.closing))
+        {
+            output.frames.clear();
+            output.size = 0;
+            output.open = false;
+            output.writing = false;
+            close = true;
             break;
         }
+
+        if(frames.empty() == false)
+        {
+            // the rest goes back before the frames queued meanwhile
+            size_t size = 0;
+            for(auto &frame: frames)
+            {
+                size += frame->size();
+            }
+            frames.insert(frames.end(), output.frames.begin(), output.frames.end());
+            output.frames.swap(frames);
+            output.size += size - offset;
+            output.offset = offset;
+            output.blocked = true;
+            output.writing = false;
+            blocked = true;
+            break;
+        }
+
+        if(output.frames.empty())
+        {
+            output.writing = false;
+            close = output.closing;
+            break;
+        }
+
+        frames.swap(output.frames);
+        output.size = 0;
+        offset = 0;
+    }
+
+    if(blocked)
+    {
+        m_server->PollWritable(connID);
+    }
+    else if(close)
+    {
+        if(error)
+        {
+            LOG(std::string("websocket write error: #") + std::to_string(connID), LogWriter::LogType::Error);
+        }
+        m_server->CloseConnection(connID);
     }
 }
 
-bool WebSocketServer::ProcessRequest(Request &request)
+// the frames are written from the shared buffers with as few calls as possible starting from the offset
+// in the first one, the count of the bytes the socket took is returned
+size_t WebSocketServer::WriteFrames(int connID, const std::deque<Frame> &frames, size_t offset)
 {
+    std::vector<struct iovec> vector;
+    vector.reserve(std::min(frames.size(), static_cast<size_t>(IOV_MAX)));
+    size_t total = 0;
+
+    auto it = frames.begin();
+    while(it != frames.end())
+    {
+        size_t size = 0;
+        vector.clear();
+        for(;it != frames.end() && vector.size() < IOV_MAX;++ it)
+        {
+            struct iovec iov;
+            iov.iov_base = const_cast<uint8_t *>((*it)->data()) + offset;
+            iov.iov_len = (*it)->size() - offset;
+            offset = 0;
+            size += iov.iov_len;
+            vector.push_back(iov);
+        }
+
+        size_t written = m_server->WriteVNoWait(connID, vector.data(), vector.size());
+        if(written == static_cast<size_t>(ERROR))
+        {
+            return written;
+        }
+        total += written;
+        if(written < size)
+        {
+            break;
+        }
+    }
+
+    return total;
+}
+
+void WebSocketServer::CheckAlive()
+{
+    if(Now() < m_nextCheck)
+    {
+        return;
+    }
+
+    uint64_t pingInterval = std::max(m_config.GetWsPingInterval(), 0);
+    uint64_t pongTimeout = std::max(m_config.GetWsPongTimeout(), 0);
+    uint64_t handshakeTimeout = std::max(m_config.GetWsHandshakeTimeout(), 0);
+    std::vector<int> ping;
+    std::vector<std::pair<int, bool>> reaped;
+
+    {
+        Lock lock(m_queueMutex);
+
+        uint64_t now = Now();
+        m_nextCheck = now + KEEPALIVE_TICK;
+
+        // only the connections which deadline has passed are visited, the activity only moves
+        // the last activity time and the timer is put back with the actual deadline when it expires
+        while(m_aliveTimers.empty() == false && m_aliveTimers.top().deadline <= now)
+        {
+            AliveTimer timer = m_aliveTimers.top();
+            m_aliveTimers.pop();
+
+            auto connection = GetConnection(timer.connID);
+            if(connection == nullptr || connection->serial != timer.serial || connection->closing)
+            {
+                continue;
+            }
+
+            // the connection that is dispatched now is alive anyway
+            if(connection->dispatching)
+            {
+                m_aliveTimers.push({ now + KEEPALIVE_TICK, timer.connID, timer.serial });
+                continue;
+            }
+
+            uint64_t deadline = GetAliveDeadline(*connection);
+            if(deadline == 0)
+            {
+                continue;
+            }
+            if(deadline > now)
+            {
+                m_aliveTimers.push({ deadline, timer.connID, timer.serial });
+                continue;
+            }
+
+            if(connection->handshake == false)
+            {
+                if(handshakeTimeout > 0)
+                {
+                    reaped.emplace_back(connection->connID, false);
+                }
+                else
+                {
+                    m_aliveTimers.push({ now + pingInterval, timer.connID, timer.serial });
+                }
+            }
+            else if(connection->pingPending)
+            {
+                reaped.emplace_back(connection->connID, true);
+            }
+            else
+            {
+                connection->pingPending = true;
+                connection->pingTime = now;
+                ping.push_back(connection->connID);
+                m_aliveTimers.push({ now + pongTimeout, timer.connID, timer.serial });
+            }
+        }
+
+        m_reapedCount += reaped.size();
+    }
+
+    if(ping.empty() == false)
+    {
+        Lock lock(m_outputMutex);
+        for(int connID: ping)
+        {
+            QueueFrame(connID, m_pingFrame);
+        }
+    }
+
+    // closing calls OnClosed that takes the queue lock again
+    for(auto &entry: reaped)
+    {
+        LOG(std::string("websocket connection timed out: #") + std::to_string(entry.first), LogWriter::LogType::Access);
+        if(entry.second)
+        {
+            CloseConnection(entry.first, CloseCode::GoingAway);
+        }
+        else
+        {
+            m_server->CloseConnection(entry.first);
+        }
+    }
+}
+
+// the time the connection has to show some activity by, 0 if it isn't checked at all
+uint64_t WebSocketServer::GetAliveDeadline(const RequestData &requestData) const
+{
+    uint64_t pingInterval = std::max(m_config.GetWsPingInterval(), 0);
+    uint64_t pongTimeout = std::max(m_config.GetWsPongTimeout(), 0);
+    uint64_t handshakeTimeout = std::max(m_config.GetWsHandshakeTimeout(), 0);
+
+    if(requestData.handshake == false)
+    {
+        // without the handshake timeout the connection is only checked again later to be pinged after the handshake
+        return requestData.lastActivity + (handshakeTimeout > 0 ? handshakeTimeout : pingInterval);
+    }
+    if(pingInterval == 0)
+    {
+        return 0;
+    }
+
+    return requestData.pingPending ? requestData.pingTime + pongTimeout : requestData.lastActivity + pingInterval;
+}
+
+uint64_t WebSocketServer::Now()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool WebSocketServer::ProcessRequest(RequestData &requestData)
+{
+    Request &request = requestData.request;
     Response response(request.GetConnectionID(), m_config);
     bool processed = false;
     bool matched = false;
@@ -420,18 +1674,7 @@ bool WebSocketServer::ProcessRequest(Request &request)
     {
         if(m_config.GetWsProcessDefault() == true)
         {
-            std::string key = request.GetHeader().GetHeader("Sec-WebSocket-Key");
-            key = key + WEBSOCKET_KEY_TOKEN;
-
-            uint8_t *buffer = Data::Sha1Digest(key);
-            key = Data::Base64Encode(buffer, 20);
-
-            response.SetResponseCode(101);
-            response.AddHeader(HttpHeader::HeaderType::Date, FileSystem::GetDateTime());
-            response.AddHeader(HttpHeader::HeaderType::Upgrade, "websocket");
-            response.AddHeader(HttpHeader::HeaderType::Connection, "upgrade");
-            response.AddHeader("Sec-WebSocket-Accept", key);
-            response.AddHeader("Sec-WebSocket-Version", WS_VERSION);
+            return SendHandshake(requestData);
         }
         else
         {
@@ -442,12 +1685,67 @@ bool WebSocketServer::ProcessRequest(Request &request)
     return response.Send(m_server.get());
 }
 
-bool WebSocketServer::ProcessWsRequest(Request &request, const RequestWebSocket &wsRequest)
+// the handshake is answered with the prebuilt header, the accept key is computed on the stack
+bool WebSocketServer::SendHandshake(RequestData &requestData)
 {
+    Request &request = requestData.request;
+    const std::string &key = request.GetHeader().GetHeader("Sec-WebSocket-Key");
+    if(key.size() != WS_KEY_SIZE)
+    {
+        LOG("#" + std::to_string(requestData.connID) + ": wrong websocket key", LogWriter::LogType::Error);
+        Response response(request.GetConnectionID(), m_config);
+        response.SetResponseCode(400);
+        response.Send(m_server.get());
+        return false;
+    }
+
+    uint8_t buffer[WS_KEY_SIZE + sizeof(WEBSOCKET_KEY_TOKEN) - 1];
+    std::memcpy(buffer, key.data(), WS_KEY_SIZE);
+    std::memcpy(buffer + WS_KEY_SIZE, WEBSOCKET_KEY_TOKEN, sizeof(WEBSOCKET_KEY_TOKEN) - 1);
+    uint8_t digest[SHA1_DIGEST_SIZE];
+    Data::Sha1Digest(buffer, sizeof(buffer), digest);
+
+    char accept[WS_ACCEPT_SIZE + 2];
+    Data::Base64Encode(digest, SHA1_DIGEST_SIZE, accept);
+    accept[WS_ACCEPT_SIZE] = CR;
+    accept[WS_ACCEPT_SIZE + 1] = LF;
+
+    std::string tail;
+#ifdef WITH_ZLIB
+    std::string extension;
+    if(NegotiateCompression(requestData, extension))
+    {
+        tail = "Sec-WebSocket-Extensions: " + extension + "\r\n";
+    }
+#endif
+    tail += "Date: " + ClockCache::GetDateTime() + "\r\n\r\n";
+
+    struct iovec iov[3];
+    iov[0].iov_base = const_cast<char *>(m_handshakeHeader.data());
+    iov[0].iov_len = m_handshakeHeader.size();
+    iov[1].iov_base = accept;
+    iov[1].iov_len = sizeof(accept);
+    iov[2].iov_base = const_cast<char *>(tail.data());
+    iov[2].iov_len = tail.size();
+
+    return m_server->WriteV(request.GetConnectionID(), iov, 3);
+}
+
+bool WebSocketServer::ProcessWsRequest(RequestData &requestData, MessageType type, const ByteArray &data)
+{
+    return ProcessWsRequest(requestData, type, data.data(), data.size(), &data);
+}
+
+// the message is copied only if there is a handler that takes the buffer and the message isn't one yet
+bool WebSocketServer::ProcessWsRequest(RequestData &requestData, MessageType type, const uint8_t *data, size_t size, const ByteArray *message)
+{
+    Request &request = requestData.request;
     ResponseWebSocket response(request.GetConnectionID());
+#ifdef WITH_ZLIB
+    response.SetCompression(requestData.deflate.get(), m_config.GetWsCompressionMinSize());
+#endif
     bool processed = false;
 
-    auto type = wsRequest.GetType();
     switch(type)
     {
         case MessageType::Text:
@@ -456,23 +1754,36 @@ bool WebSocketServer::ProcessWsRequest(Request &request, const RequestWebSocket
             {
                 if(route.IsMatch(request))
                 {
+                    auto &view = route.GetFunctionView();
                     auto &f = route.GetFunctionMessage();
-                    if(f != nullptr)
+                    try
                     {
-                        try
+                        if(view != nullptr)
                         {
-                            if(f(request, response, wsRequest.GetData()) == true)
+                            if(view(request, response, data, size) == true)
+                            {
+                                break;
+                            }
+                        }
+                        else if(f != nullptr)
+                        {
+                            if(message == nullptr)
+                            {
+                                requestData.payload.assign(data, data + size);
+                                message = &requestData.payload;
+                            }
+                            if(f(request, response, *message) == true)
                             {
                                 break;
                             }
                         }
-                        catch(...) { }
                     }
+                    catch(...) { }
                 }
             }
             break;
         case MessageType::Ping:
-            response.WriteBinary(wsRequest.GetData());
+            response.WriteBinary(ByteArray(data, data + size));
             response.SetMessageType(MessageType::Pong);
             break;
         case MessageType::Close:
@@ -483,7 +1794,83 @@ bool WebSocketServer::ProcessWsRequest(Request &request, const RequestWebSocket
 
     if(!response.IsEmpty())
     {
-        response.Send(m_server.get());
+        QueueResponse(response, &requestData);
+    }
+
+    return true;
+}
+
+#ifdef WITH_ZLIB
+bool WebSocketServer::NegotiateCompression(RequestData &requestData, std::string &extension)
+{
+    std::string offers = requestData.request.GetHeader().GetHeader("Sec-WebSocket-Extensions");
+    if(m_config.GetWsCompressionEnabled() == false || offers.empty())
+    {
+        return false;
+    }
+
+    WebSocketDeflate::Params config;
+    config.serverMaxWindowBits = config.clientMaxWindowBits = m_config.GetWsCompressionWindowBits();
+    config.serverNoContextTakeover = config.clientNoContextTakeover = !m_config.GetWsContextTakeover();
+
+    WebSocketDeflate::Params params;
+    if(WebSocketDeflate::Negotiate(offers, config, params, extension) == false)
+    {
+        return false;
+    }
+
+    std::unique_ptr<WebSocketDeflate> deflate(new WebSocketDeflate(params, true, m_config.GetCompressionLevel()));
+    if(deflate->IsValid() == false)
+    {
+        return false;
+    }
+
+    // the connection goes on without compression when the memory limit is reached
+    {
+        Lock lock(m_queueMutex);
+        if(m_deflateMemory + deflate->GetMemoryUsage() > m_config.GetWsCompressionMemoryLimit())
+        {
+            LOG("compression memory limit is reached: #" + std::to_string(requestData.connID), LogWriter::LogType::Info);
+            return false;
+        }
+        m_deflateMemory += deflate->GetMemoryUsage();
+    }
+    requestData.deflate = std::move(deflate);
+
+    return true;
+}
+#endif
+
+bool WebSocketServer::ProcessWsChunk(RequestData &requestData, const ByteArray &chunk, bool last)
+{
+    Request &request = requestData.request;
+    ResponseWebSocket response(request.GetConnectionID());
+#ifdef WITH_ZLIB
+    response.SetCompression(requestData.deflate.get(), m_config.GetWsCompressionMinSize());
+#endif
+
+    for(auto &route: m_routes)
+    {
+        if(route.IsMatch(request))
+        {
+            auto &f = route.GetFunctionChunk();
+            if(f != nullptr)
+            {
+                try
+                {
+                    if(f(request, response, chunk, last) == true)
+                    {
+                        break;
+                    }
+                }
+                catch(...) { }
+            }
+        }
+    }
+
+    if(!response.IsEmpty())
+    {
+        QueueResponse(response, &requestData);
     }
 
     return true;
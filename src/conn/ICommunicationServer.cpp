@@ -163,28 +163,34 @@ bool ICommunicationServer::Write(int connID, ByteArray &data)
 
 bool ICommunicationServer::Write(int connID, ByteArray &data, size_t size)
 {
-    ClearError();
-
-    if(m_initialized == false || m_connected == false)
     {
-        SetLastError("not initialized or not connected");
-        return false;
+        // the error state is shared by all the connections
+        Lock lock(m_writeMutex);
+        ClearError();
+
+        if(m_initialized == false || m_connected == false)
+        {
+            SetLastError("not initialized or not connected");
+            return false;
+        }
     }
 
     bool retval = false;
-    Lock lock(m_writeMutex);
 
     try
     {
+        // the socket pool locks only this connection, the lock below guards the error only
         auto pos = m_sockets.Write(data.data(), size, connID);
         retval = (pos == size);
         if(retval == false)
         {
+            Lock lock(m_writeMutex);
             SetLastError("send " + std::to_string(pos) + " of " + std::to_string(size) + " bytes");
         }
     }
     catch(const std::exception &ex)
     {
+        Lock lock(m_writeMutex);
         SetLastError(std::string("CommunicationServer::Write() exception: ") + ex.what());
         retval = false;
     }
@@ -192,6 +198,107 @@ bool ICommunicationServer::Write(int connID, ByteArray &data, size_t size)
     return retval;
 }
 
+bool ICommunicationServer::WriteV(int connID, const struct iovec *iov, int count)
+{
+    {
+        Lock lock(m_writeMutex);
+        ClearError();
+
+        if(m_initialized == false || m_connected == false)
+        {
+            SetLastError("not initialized or not connected");
+            return false;
+        }
+    }
+
+    size_t size = 0;
+    for(int i = 0;i < count;i ++)
+    {
+        size += iov[i].iov_len;
+    }
+
+    bool retval = false;
+
+    try
+    {
+        auto pos = m_sockets.WriteV(iov, count, connID);
+        retval = (pos == size);
+        if(retval == false)
+        {
+            Lock lock(m_writeMutex);
+            SetLastError("send " + std::to_string(pos) + " of " + std::to_string(size) + " bytes");
+        }
+    }
+    catch(const std::exception &ex)
+    {
+        Lock lock(m_writeMutex);
+        SetLastError(std::string("CommunicationServer::WriteV() exception: ") + ex.what());
+        retval = false;
+    }
+
+    return retval;
+}
+
+// the socket takes as much as it can now, the rest is written after it's reported writable
+size_t ICommunicationServer::WriteVNoWait(int connID, const struct iovec *iov, int count)
+{
+    if(m_initialized == false || m_connected == false)
+    {
+        Lock lock(m_writeMutex);
+        SetLastError("not initialized or not connected");
+        return ERROR;
+    }
+
+    auto retval = m_sockets.WriteVNoWait(iov, count, connID);
+    if(retval == static_cast<size_t>(ERROR))
+    {
+        Lock lock(m_writeMutex);
+        SetLastError("CommunicationServer::WriteVNoWait() error");
+    }
+
+    return retval;
+}
+
+void ICommunicationServer::PollWritable(int connID)
+{
+    m_sockets.PollWritable(connID);
+}
+
+bool ICommunicationServer::SendFile(int connID, int fileFd, size_t offset, size_t size)
+{
+    {
+        Lock lock(m_writeMutex);
+        ClearError();
+
+        if(m_initialized == false || m_connected == false)
+        {
+            SetLastError("not initialized or not connected");
+            return false;
+        }
+    }
+
+    bool retval = false;
+
+    try
+    {
+        auto pos = m_sockets.SendFile(fileFd, offset, size, connID);
+        retval = (pos == size);
+        if(retval == false)
+        {
+            Lock lock(m_writeMutex);
+            SetLastError("send " + std::to_string(pos) + " of " + std::to_string(size) + " bytes: " + m_sockets.GetLastError());
+        }
+    }
+    catch(const std::exception &ex)
+    {
+        Lock lock(m_writeMutex);
+        SetLastError(std::string("CommunicationServer::SendFile() exception: ") + ex.what());
+        retval = false;
+    }
+
+    return retval;
+}
+
 void *ICommunicationServer::ReadThread(bool &running)
 {
     int retval = (-1);
@@ -205,6 +312,10 @@ void *ICommunicationServer::ReadThread(bool &running)
             {
                 for (int i = 0; i < m_sockets.GetCount(); i++)
                 {
+                    if(m_sockets.IsWritable(i) && m_writeReadyCallback != nullptr)
+                    {
+                        m_writeReadyCallback(i);
+                    }
                     if(m_sockets.IsPollError(i))
                     {
                         CloseConnection(i);
@@ -0,0 +1,111 @@
+#include "Lock.h"
+#include "Platform.h"
+#include "FileSystem.h"
+#include "ClockCache.h"
+
+#define TICK 50 // msec.
+
+
+using namespace WebCpp;
+
+ClockCache::Slot ClockCache::m_slots[DATE_SLOTS] = {};
+std::atomic<unsigned int> ClockCache::m_current(0);
+std::atomic<bool> ClockCache::m_running(false);
+ThreadWorker ClockCache::m_task;
+Mutex ClockCache::m_mutex;
+int ClockCache::m_refCount = 0;
+
+bool ClockCache::Run()
+{
+    Lock lock(m_mutex);
+
+    m_refCount ++;
+    if(m_refCount > 1)
+    {
+        return true;
+    }
+
+    Update(time(nullptr));
+    m_task.SetFunction(&ClockCache::Task);
+    m_running = m_task.Start();
+    if(m_running == false)
+    {
+        // the failed start doesn't hold a reference
+        m_refCount --;
+    }
+
+    return m_running;
+}
+
+void ClockCache::Stop()
+{
+    Lock lock(m_mutex);
+
+    if(m_refCount > 0)
+    {
+        m_refCount --;
+        if(m_refCount == 0)
+        {
+            m_running = false;
+            m_task.Stop(true);
+        }
+    }
+}
+
+bool ClockCache::IsRunning()
+{
+    return m_running;
+}
+
+std::string ClockCache::GetDateTime()
+{
+    if(m_running == false)
+    {
+        return FileSystem::GetDateTime();
+    }
+
+    return std::string(m_slots[m_current.load(std::memory_order_acquire)].value);
+}
+
+time_t ClockCache::GetTime()
+{
+    if(m_running == false)
+    {
+        return time(nullptr);
+    }
+
+    return m_slots[m_current.load(std::memory_order_acquire)].time;
+}
+
+void *ClockCache::Task(bool &running)
+{
+    time_t last = m_slots[m_current].time;
+
+    while(running)
+    {
+        time_t now = time(nullptr);
+        if(now != last)
+        {
+            Update(now);
+            last = now;
+        }
+
+        WebCpp::SleepMs(TICK);
+    }
+
+    return nullptr;
+}
+
+// readers take the last published slot without locking,
+// so the next slot is filled first and published after that
+void ClockCache::Update(time_t now)
+{
+    unsigned int next = (m_current.load(std::memory_order_relaxed) + 1) % DATE_SLOTS;
+    struct tm timeinfo;
+
+    gmtime_r(&now, &timeinfo);
+    strftime(m_slots[next].value, DATE_LENGTH, "%a, %d %b %Y %H:%M:%S GMT", &timeinfo);
+    m_slots[next].time = now;
+
+    m_current.store(next, std::memory_order_release);
+}
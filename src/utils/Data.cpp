@@ -1,4 +1,10 @@
 #include <stdexcept>
+#include <cstring>
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__SHA__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include "Sha1.h"
 #include "Sha256.h"
 #include "Data.h"
@@ -57,6 +63,38 @@ std::string Data::Base64Encode(const unsigned char* bytes_to_encode, size_t in_l
 
 }
 
+// the output buffer should have room for 4 * ((size + 2) / 3) chars, no terminating zero is added
+size_t Data::Base64Encode(const uint8_t *data, size_t size, char *out)
+{
+    const char *table = base64_chars.c_str();
+    char *ptr = out;
+    size_t pos = 0;
+
+    for(;pos + 3 <= size;pos += 3)
+    {
+        uint32_t value = (data[pos] << 16) | (data[pos + 1] << 8) | data[pos + 2];
+        *ptr++ = table[(value >> 18) & 0x3F];
+        *ptr++ = table[(value >> 12) & 0x3F];
+        *ptr++ = table[(value >> 6) & 0x3F];
+        *ptr++ = table[value & 0x3F];
+    }
+
+    if(pos < size)
+    {
+        uint32_t value = data[pos] << 16;
+        if(pos + 1 < size)
+        {
+            value |= data[pos + 1] << 8;
+        }
+        *ptr++ = table[(value >> 18) & 0x3F];
+        *ptr++ = table[(value >> 12) & 0x3F];
+        *ptr++ = (pos + 1 < size) ? table[(value >> 6) & 0x3F] : '=';
+        *ptr++ = '=';
+    }
+
+    return ptr - out;
+}
+
 std::string Data::Base64Encode(const std::string &str)
 {
     return Data::Base64Encode(reinterpret_cast<unsigned char const*>(str.c_str()), str.size());
@@ -118,6 +156,146 @@ uint8_t* Data::Sha1Digest(const std::string &string)
     return checksum.digest();
 }
 
+// the one-shot digest that needs no allocation, the result is 20 bytes
+void Data::Sha1Digest(const uint8_t *data, size_t size, uint8_t *digest)
+{
+    uint32_t state[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+
+    size_t blocks = size / 64;
+    Sha1Blocks(state, data, blocks);
+
+    // the rest of the data with the padding and the length takes one or two blocks
+    uint8_t tail[128] = {};
+    size_t rest = size - blocks * 64;
+    std::memcpy(tail, data + blocks * 64, rest);
+    tail[rest] = 0x80;
+    size_t tailSize = (rest < 56 ? 64 : 128);
+    uint64_t bits = static_cast<uint64_t>(size) * 8;
+    for(int i = 0;i < 8;i ++)
+    {
+        tail[tailSize - 1 - i] = static_cast<uint8_t>(bits >> (i * 8));
+    }
+    Sha1Blocks(state, tail, tailSize / 64);
+
+    for(int i = 0;i < 5;i ++)
+    {
+        digest[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+    }
+}
+
+#if defined(__SHA__) && defined(__SSE4_1__)
+#define SHA1_ROUNDS(abcd, e, group) \
+    switch((group) / 5) \
+    { \
+        case 0: abcd = _mm_sha1rnds4_epu32(abcd, e, 0); break; \
+        case 1: abcd = _mm_sha1rnds4_epu32(abcd, e, 1); break; \
+        case 2: abcd = _mm_sha1rnds4_epu32(abcd, e, 2); break; \
+        default: abcd = _mm_sha1rnds4_epu32(abcd, e, 3); break; \
+    }
+
+void Data::Sha1Blocks(uint32_t *state, const uint8_t *data, size_t count)
+{
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0x1B);
+    __m128i e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+
+    for(size_t block = 0;block < count;block ++, data += 64)
+    {
+        __m128i abcdSaved = abcd;
+        __m128i eSaved = e0;
+        __m128i msg[4];
+        __m128i e[2];
+        e[0] = e0;
+
+        // each group of 4 rounds takes the next 4 words of the schedule that is expanded on the go
+        for(int group = 0;group < 20;group ++)
+        {
+            __m128i &current = e[group & 1];
+            __m128i &next = e[(group + 1) & 1];
+            if(group < 4)
+            {
+                msg[group] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + group * 16)), mask);
+            }
+
+            current = (group == 0 ? _mm_add_epi32(current, msg[0]) : _mm_sha1nexte_epu32(current, msg[group & 3]));
+            next = abcd;
+            if(group >= 3 && group <= 18)
+            {
+                msg[(group + 1) & 3] = _mm_sha1msg2_epu32(msg[(group + 1) & 3], msg[group & 3]);
+            }
+            SHA1_ROUNDS(abcd, current, group)
+            if(group >= 1 && group <= 16)
+            {
+                msg[(group - 1) & 3] = _mm_sha1msg1_epu32(msg[(group - 1) & 3], msg[group & 3]);
+            }
+            if(group >= 2 && group <= 17)
+            {
+                msg[(group - 2) & 3] = _mm_xor_si128(msg[(group - 2) & 3], msg[group & 3]);
+            }
+        }
+
+        e0 = _mm_sha1nexte_epu32(e[0], eSaved);
+        abcd = _mm_add_epi32(abcd, abcdSaved);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+}
+#else
+static inline uint32_t rol(uint32_t value, int bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+void Data::Sha1Blocks(uint32_t *state, const uint8_t *data, size_t count)
+{
+    for(size_t block = 0;block < count;block ++, data += 64)
+    {
+        uint32_t w[80];
+        for(int i = 0;i < 16;i ++)
+        {
+            w[i] = (static_cast<uint32_t>(data[i * 4]) << 24) | (data[i * 4 + 1] << 16) | (data[i * 4 + 2] << 8) | data[i * 4 + 3];
+        }
+        for(int i = 16;i < 80;i ++)
+        {
+            w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        uint32_t temp;
+        for(int i = 0;i < 20;i ++)
+        {
+            temp = rol(a, 5) + ((b & c) | (~b & d)) + e + 0x5a827999 + w[i];
+            e = d; d = c; c = rol(b, 30); b = a; a = temp;
+        }
+        for(int i = 20;i < 40;i ++)
+        {
+            temp = rol(a, 5) + (b ^ c ^ d) + e + 0x6ed9eba1 + w[i];
+            e = d; d = c; c = rol(b, 30); b = a; a = temp;
+        }
+        for(int i = 40;i < 60;i ++)
+        {
+            temp = rol(a, 5) + ((b & c) | (b & d) | (c & d)) + e + 0x8f1bbcdc + w[i];
+            e = d; d = c; c = rol(b, 30); b = a; a = temp;
+        }
+        for(int i = 60;i < 80;i ++)
+        {
+            temp = rol(a, 5) + (b ^ c ^ d) + e + 0xca62c1d6 + w[i];
+            e = d; d = c; c = rol(b, 30); b = a; a = temp;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+}
+#endif
+
 std::string Data::Sha256(const std::string &string)
 {
     SHA256 hash;
@@ -125,13 +303,247 @@ std::string Data::Sha256(const std::string &string)
 }
 
 
+void Data::Mask(const uint8_t *src, uint8_t *dst, size_t size, const uint8_t *mask, size_t offset)
+{
+    // the mask rotated so that its first byte applies to src[0]
+    uint8_t rotated[4];
+    for(size_t i = 0;i < 4;i ++)
+    {
+        rotated[i] = mask[(offset + i) % 4];
+    }
+    uint32_t mask32;
+    std::memcpy(&mask32, rotated, sizeof(mask32));
+
+    size_t pos = 0;
+#if defined(__AVX2__)
+    const __m256i mask256 = _mm256_set1_epi32(static_cast<int>(mask32));
+    for(;pos + 32 <= size;pos += 32)
+    {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + pos));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + pos), _mm256_xor_si256(block, mask256));
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i mask128 = _mm_set1_epi32(static_cast<int>(mask32));
+    for(;pos + 16 <= size;pos += 16)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + pos));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + pos), _mm_xor_si128(block, mask128));
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t mask128 = vreinterpretq_u8_u32(vdupq_n_u32(mask32));
+    for(;pos + 16 <= size;pos += 16)
+    {
+        vst1q_u8(dst + pos, veorq_u8(vld1q_u8(src + pos), mask128));
+    }
+#endif
+    uint64_t mask64 = (static_cast<uint64_t>(mask32) << 32) | mask32;
+    for(;pos + 8 <= size;pos += 8)
+    {
+        uint64_t block;
+        std::memcpy(&block, src + pos, sizeof(block));
+        block ^= mask64;
+        std::memcpy(dst + pos, &block, sizeof(block));
+    }
+    for(;pos < size;pos ++)
+    {
+        dst[pos] = src[pos] ^ rotated[pos % 4];
+    }
+}
+
 #ifdef WITH_ZLIB
 #include "zlib.h"
 #define CHUNK 0x4000
 
-ByteArray Data::Compress(const ByteArray &data)
+Data::Deflater::Deflater(Format format, int level, int windowBits, int memLevel)
+{
+    switch(format)
+    {
+        case Format::Raw: windowBits = -windowBits; break;
+        case Format::Gzip: windowBits = 16 + windowBits; break;
+        default: break;
+    }
+
+    m_stream = new z_stream {};
+    m_stream->zalloc = Z_NULL;
+    m_stream->zfree = Z_NULL;
+    m_stream->opaque = Z_NULL;
+    if(deflateInit2(m_stream, level, Z_DEFLATED, windowBits, memLevel, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        delete m_stream;
+        m_stream = nullptr;
+    }
+}
+
+Data::Deflater::~Deflater()
+{
+    if(m_stream != nullptr)
+    {
+        deflateEnd(m_stream);
+        delete m_stream;
+    }
+}
+
+bool Data::Deflater::IsValid() const
+{
+    return (m_stream != nullptr);
+}
+
+bool Data::Deflater::Process(const uint8_t *data, size_t size, ByteArray &out, bool finish)
+{
+    return Deflate(data, size, out, finish ? Z_FINISH : Z_NO_FLUSH);
+}
+
+bool Data::Deflater::Flush(const uint8_t *data, size_t size, ByteArray &out)
+{
+    return Deflate(data, size, out, Z_SYNC_FLUSH);
+}
+
+bool Data::Deflater::Reset()
+{
+    return (m_stream != nullptr && deflateReset(m_stream) == Z_OK);
+}
+
+bool Data::Deflater::Deflate(const uint8_t *data, size_t size, ByteArray &out, int flush)
+{
+    if(m_stream == nullptr)
+    {
+        return false;
+    }
+
+    m_stream->next_in = const_cast<uint8_t *>(data);
+    m_stream->avail_in = size;
+
+    int err;
+    do
+    {
+        size_t pos = out.size();
+        out.resize(pos + CHUNK);
+        m_stream->next_out = out.data() + pos;
+        m_stream->avail_out = CHUNK;
+        err = deflate(m_stream, flush);
+        out.resize(pos + CHUNK - m_stream->avail_out);
+        if(err == Z_STREAM_ERROR)
+        {
+            return false;
+        }
+    }
+    while(m_stream->avail_out == 0 || (flush == Z_FINISH && err != Z_STREAM_END));
+
+    return true;
+}
+
+Data::Inflater::Inflater(Deflater::Format format, int windowBits)
+{
+    switch(format)
+    {
+        case Deflater::Format::Raw: windowBits = -windowBits; break;
+        case Deflater::Format::Gzip: windowBits = 16 + windowBits; break;
+        default: break;
+    }
+
+    m_stream = new z_stream {};
+    m_stream->zalloc = Z_NULL;
+    m_stream->zfree = Z_NULL;
+    m_stream->opaque = Z_NULL;
+    if(inflateInit2(m_stream, windowBits) != Z_OK)
+    {
+        delete m_stream;
+        m_stream = nullptr;
+    }
+}
+
+Data::Inflater::~Inflater()
+{
+    if(m_stream != nullptr)
+    {
+        inflateEnd(m_stream);
+        delete m_stream;
+    }
+}
+
+bool Data::Inflater::IsValid() const
 {
-    return data;
+    return (m_stream != nullptr);
+}
+
+bool Data::Inflater::Process(const uint8_t *data, size_t size, ByteArray &out, size_t limit)
+{
+    if(m_stream == nullptr)
+    {
+        return false;
+    }
+
+    m_stream->next_in = const_cast<uint8_t *>(data);
+    m_stream->avail_in = size;
+
+    while(m_stream->avail_in > 0)
+    {
+        size_t pos = out.size();
+        out.resize(pos + CHUNK);
+        m_stream->next_out = out.data() + pos;
+        m_stream->avail_out = CHUNK;
+        int err = inflate(m_stream, Z_SYNC_FLUSH);
+        out.resize(pos + CHUNK - m_stream->avail_out);
+
+        if(out.size() > limit)
+        {
+            return false;
+        }
+
+        if(err == Z_STREAM_END)
+        {
+            // the data after the final block starts a new stream
+            inflateReset(m_stream);
+        }
+        else if(err == Z_BUF_ERROR)
+        {
+            // no progress is possible, the input is incomplete
+            if(m_stream->avail_out != 0)
+            {
+                break;
+            }
+        }
+        else if(err != Z_OK)
+        {
+            return false;
+        }
+    }
+
+    // the output buffer was filled up, there could be some pending output
+    while(m_stream->avail_out == 0)
+    {
+        size_t pos = out.size();
+        out.resize(pos + CHUNK);
+        m_stream->next_out = out.data() + pos;
+        m_stream->avail_out = CHUNK;
+        int err = inflate(m_stream, Z_SYNC_FLUSH);
+        out.resize(pos + CHUNK - m_stream->avail_out);
+        if(out.size() > limit || (err != Z_OK && err != Z_BUF_ERROR && err != Z_STREAM_END))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Data::Inflater::Reset()
+{
+    return (m_stream != nullptr && inflateReset(m_stream) == Z_OK);
+}
+
+ByteArray Data::Compress(const ByteArray &data, int level)
+{
+    ByteArray retval;
+    Deflater deflater(Deflater::Format::Zlib, level);
+    retval.reserve(deflateBound(nullptr, data.size()));
+    if(deflater.Process(data.data(), data.size(), retval, true) == false)
+    {
+        return ByteArray();
+    }
+
+    return retval;
 }
 
 ByteArray Data::Uncompress(const ByteArray &data)
@@ -149,7 +561,9 @@ ByteArray Data::Uncompress(const ByteArray &data)
         strm.next_in = nullptr;
         strm.avail_in = 0;
 
-        if(inflateInit2(&strm, -MAX_WBITS) != Z_OK)
+        // both the zlib format (RFC 1950) and the raw deflate stream are used as 'deflate' in the wild
+        bool zlibHeader = (data.size() >= 2 && (data[0] & 0x0F) == Z_DEFLATED && ((data[0] << 8) | data[1]) % 31 == 0);
+        if(inflateInit2(&strm, zlibHeader ? MAX_WBITS : -MAX_WBITS) != Z_OK)
         {
             throw std::runtime_error("");
         }
@@ -197,9 +611,17 @@ ByteArray Data::Uncompress(const ByteArray &data)
     return retval;
 }
 
-ByteArray Data::Zip(const ByteArray &data)
+ByteArray Data::Zip(const ByteArray &data, int level)
 {
-    return data;
+    ByteArray retval;
+    Deflater deflater(Deflater::Format::Gzip, level);
+    retval.reserve(deflateBound(nullptr, data.size()) + 18);
+    if(deflater.Process(data.data(), data.size(), retval, true) == false)
+    {
+        return ByteArray();
+    }
+
+    return retval;
 }
 
 ByteArray Data::Unzip(const ByteArray &data)
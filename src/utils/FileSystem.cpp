@@ -298,15 +298,7 @@ bool FileSystem::DeleteFolder(const std::string &path)
 
 std::string FileSystem::GetDateTime()
 {
-    time_t tm;
-    struct tm * timeinfo;
-    char buffer[30];
-
-    time(&tm);
-    const time_t *t = &tm;
-    timeinfo = gmtime(t);
-    strftime(buffer, 30, "%a, %d %b %Y %H:%M:%S GMT", timeinfo);
-    return buffer;
+    return Time2String(time(nullptr));
 }
 
 std::string FileSystem::GetFileModifiedTime(const std::string &file)
@@ -314,17 +306,51 @@ std::string FileSystem::GetFileModifiedTime(const std::string &file)
     struct stat result;
     if(stat(file.c_str(), &result) == 0)
     {
-        auto mod_time = result.st_mtime;
-        const time_t *t = &mod_time;
-        struct tm * timeinfo = gmtime(t);
-        char buffer[30];
-        strftime(buffer, 30, "%a, %d %b %Y %H:%M:%S GMT", timeinfo);
-        return buffer;
+        return Time2String(result.st_mtime);
     }
 
     return "";
 }
 
+std::string FileSystem::Time2String(time_t time)
+{
+    struct tm timeinfo;
+    char buffer[30];
+
+    gmtime_r(&time, &timeinfo);
+    strftime(buffer, 30, "%a, %d %b %Y %H:%M:%S GMT", &timeinfo);
+    return buffer;
+}
+
+bool FileSystem::String2Time(const std::string &str, time_t &time)
+{
+    struct tm timeinfo = {};
+
+    const char *end = strptime(str.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &timeinfo);
+    if(end == nullptr || *end != '\0')
+    {
+        return false;
+    }
+
+    time = timegm(&timeinfo);
+    return true;
+}
+
+bool FileSystem::GetFileStat(const std::string &path, FileStat &fileStat)
+{
+    struct stat result;
+    if(stat(path.c_str(), &result) == 0)
+    {
+        fileStat.size = result.st_size;
+        fileStat.modified = result.st_mtime;
+        fileStat.inode = result.st_ino;
+        fileStat.folder = S_ISDIR(result.st_mode);
+        return true;
+    }
+
+    return false;
+}
+
 void RandInit()
 {
     srand(static_cast<unsigned int>(time(nullptr)));
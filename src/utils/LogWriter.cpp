@@ -1,4 +1,5 @@
 #include "FileSystem.h"
+#include "ClockCache.h"
 #include "LogWriter.h"
 #include <iostream>
 #include <cstring>
@@ -20,7 +21,7 @@ LogWriter& LogWriter::Instance()
 
 void LogWriter::Write(const std::string &text, LogWriter::LogType type)
 {
-    std::string s = "[" + WebCpp::FileSystem::GetDateTime() + "] " + text;
+    std::string s = "[" + WebCpp::ClockCache::GetDateTime() + "] " + text;
     auto &stream = m_streams[static_cast<int>(type)];
     if(stream.is_open())
     {
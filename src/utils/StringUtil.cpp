@@ -1,5 +1,6 @@
 #include <sstream>
 #include <algorithm>
+#include <cctype>
 #include "StringUtil.h"
 #include "iostream"
 #include <iomanip>
@@ -15,10 +16,14 @@ size_t StringUtil::SearchPosition(const ByteArray &str, const ByteArray&substrin
     const uint8_t* pstr = str.data();
     const uint8_t* psubstring = substring.data();
     size_t substringLen = substring.size();
-    if(end == SIZE_MAX)
+    if(end == SIZE_MAX || end >= str.size())
     {
         end = str.size() - 1;
     }
+    if(substringLen == 0 || str.size() < substringLen || end + 1 < start + substringLen)
+    {
+        return SIZE_MAX;
+    }
 
     for(size_t pos1 = start;pos1 <= end - substringLen + 1; pos1++)
     {
@@ -244,6 +249,33 @@ bool StringUtil::String2int(const std::string &str, int &value, int base)
     }
 }
 
+// only the plain decimal digits are accepted, no sign, spaces or suffix
+bool StringUtil::String2size(const std::string &str, size_t &value)
+{
+    if(str.empty())
+    {
+        return false;
+    }
+
+    size_t result = 0;
+    for(char ch: str)
+    {
+        if(ch < '0' || ch > '9')
+        {
+            return false;
+        }
+        size_t digit = ch - '0';
+        if(result > (SIZE_MAX - digit) / 10)
+        {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+
+    value = result;
+    return true;
+}
+
 void StringUtil::ToLower(std::string &str)
 {
     std::transform(str.begin(), str.end(), str.begin(),[](unsigned char c)
@@ -273,15 +305,18 @@ ByteArray StringUtil::String2ByteArray(const std::string &string)
 void StringUtil::UrlDecode(std::string &str)
 {
     size_t from = 0;
-    while((from = str.find('%', from)) != std::string::npos)
+    while((from = str.find('%', from)) != std::string::npos && from + 2 < str.size())
     {
         std::string value(str.begin() + from + 1, str.begin() + from + 3);
         int ascii;
-        if(StringUtil::String2int(value, ascii, 16))
+        if(std::isxdigit(static_cast<unsigned char>(value[0])) && std::isxdigit(static_cast<unsigned char>(value[1])) &&
+                StringUtil::String2int(value, ascii, 16))
         {
             str.erase(from, 3);
             str.insert(from, 1, static_cast<char>(ascii));
         }
+        // the decoded character is never decoded again
+        from ++;
     }
 
     std::replace(str.begin(), str.end(), '+', ' ');
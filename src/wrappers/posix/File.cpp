@@ -1,7 +1,14 @@
 #include "File.h"
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <cstring>
+#include <cstdlib>
+#include <vector>
+
+#define FILE_PERMISSIONS 0644
+#define TEMP_FILE_PERMISSIONS 0600
+#define COPY_BUFFER_SIZE 65536
 
 
 using namespace WebCpp;
@@ -27,7 +34,7 @@ bool File::Open(const std::string &file,  Mode mode)
 
     m_file = file;
     m_mode = mode;
-    m_fd = open(m_file.c_str(), Mode2Flag(mode));
+    m_fd = open(m_file.c_str(), Mode2Flag(mode), FILE_PERMISSIONS);
     if(m_fd == (-1))
     {
         SetLastError(strerror(errno));
@@ -36,12 +43,51 @@ bool File::Open(const std::string &file,  Mode mode)
     return IsOpened();
 }
 
+bool File::OpenTemp(const std::string &folder)
+{
+    ClearError();
+    Close();
+
+    m_mode = Mode::Read | Mode::Write;
+    m_temp = true;
+    m_file = "";
+
+#ifdef O_TMPFILE
+    // the file has no name until it's linked so nothing is left behind if the process dies
+    m_fd = open(folder.c_str(), O_TMPFILE | O_RDWR, TEMP_FILE_PERMISSIONS);
+    if(m_fd != (-1))
+    {
+        return true;
+    }
+#endif
+
+    // the file system doesn't support unnamed files, a named one is used and removed on Close()
+    std::string path = folder + "/.tmpXXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+    m_fd = mkstemp(name.data());
+    if(m_fd == (-1))
+    {
+        m_temp = false;
+        SetLastError(strerror(errno));
+        return false;
+    }
+    m_file = name.data();
+
+    return true;
+}
+
 bool File::Close()
 {
     if(m_fd != (-1))
     {
         close(m_fd);
         m_fd = (-1);
+        if(m_temp && !m_file.empty())
+        {
+            unlink(m_file.c_str());
+        }
+        m_temp = false;
         return true;
     }
 
@@ -58,18 +104,126 @@ size_t File::Write(const char *buffer, size_t size)
     return write(m_fd, buffer, size);
 }
 
+bool File::Link(const std::string &path)
+{
+    ClearError();
+
+    if(m_fd == (-1))
+    {
+        SetLastError("file not opened");
+        return false;
+    }
+
+    int retval;
+    if(m_temp && m_file.empty())
+    {
+        std::string fdPath = "/proc/self/fd/" + std::to_string(m_fd);
+        retval = linkat(AT_FDCWD, fdPath.c_str(), AT_FDCWD, path.c_str(), AT_SYMLINK_FOLLOW);
+    }
+    else if(m_temp)
+    {
+        retval = rename(m_file.c_str(), path.c_str());
+    }
+    else
+    {
+        retval = link(m_file.c_str(), path.c_str());
+    }
+
+    if(retval != 0)
+    {
+        if(errno != EXDEV)
+        {
+            SetLastError(strerror(errno));
+            return false;
+        }
+        // the destination is on another file system
+        if(CopyTo(path) == false)
+        {
+            return false;
+        }
+        if(m_temp == false)
+        {
+            return true;
+        }
+    }
+
+    if(m_temp)
+    {
+        if(!m_file.empty())
+        {
+            unlink(m_file.c_str());
+        }
+        m_file = path;
+        m_temp = false;
+    }
+
+    return true;
+}
+
+bool File::CopyTo(const std::string &path)
+{
+    File file(path, Mode::Write);
+    if(file.IsOpened() == false)
+    {
+        SetLastError(file.GetLastError());
+        return false;
+    }
+
+    char buffer[COPY_BUFFER_SIZE];
+    off_t offset = 0;
+    ssize_t bytes;
+    while((bytes = pread(m_fd, buffer, COPY_BUFFER_SIZE, offset)) > 0)
+    {
+        if(file.Write(buffer, bytes) != static_cast<size_t>(bytes))
+        {
+            SetLastError("error writing " + path);
+            return false;
+        }
+        offset += bytes;
+    }
+
+    if(bytes < 0)
+    {
+        SetLastError(strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool File::IsTemp() const
+{
+    return m_temp;
+}
+
+size_t File::GetSize() const
+{
+    struct stat s;
+    if(m_fd != (-1) && fstat(m_fd, &s) == 0)
+    {
+        return s.st_size;
+    }
+
+    return 0;
+}
+
 bool File::IsOpened() const
 {
     return (m_fd != (-1));
 }
 
+int File::GetDescriptor() const
+{
+    return m_fd;
+}
+
 int File::Mode2Flag(Mode mode)
 {
     if(contains(mode, Mode::Read))
     {
         if(contains(mode, Mode::Write))
         {
-            return O_RDWR | O_TRUNC;
+            return O_RDWR | O_CREAT | O_TRUNC;
         }
         else
         {
@@ -78,7 +232,7 @@ int File::Mode2Flag(Mode mode)
     }
     else if(contains(mode, Mode::Write))
     {
-        return O_WRONLY | O_TRUNC;
+        return O_WRONLY | O_CREAT | O_TRUNC;
     }
 
     return O_RDONLY;
@@ -1,3 +1,5 @@
+#include <ctime>
+#include <cerrno>
 #include "Signal.h"
 
 
@@ -17,3 +19,19 @@ void Signal::Wait(Mutex &mutex)
 {
     pthread_cond_wait(& m_signalCondition, mutex.GetMutex());
 }
+
+// the timeout is in msec., returns false if the time is out
+bool Signal::Wait(Mutex &mutex, uint32_t timeout)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_REALTIME, &time);
+    time.tv_sec += timeout / 1000;
+    time.tv_nsec += (timeout % 1000) * 1000000L;
+    if(time.tv_nsec >= 1000000000L)
+    {
+        time.tv_sec ++;
+        time.tv_nsec -= 1000000000L;
+    }
+
+    return pthread_cond_timedwait(&m_signalCondition, mutex.GetMutex(), &time) != ETIMEDOUT;
+}
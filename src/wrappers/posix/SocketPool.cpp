@@ -4,16 +4,22 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/sendfile.h>
+#include <sys/eventfd.h>
 #include <fcntl.h>
 #include <netdb.h>
 #include <cstring>
 #include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include "common_webcpp.h"
 #include "SocketPool.h"
 #include "StringUtil.h"
 #include "Lock.h"
 
 #define MAIN_SOCKET_INDEX 0
 #define QUEUE_SIZE 10
+#define SENDFILE_BUFFER_SIZE 65536
 
 
 using namespace WebCpp;
@@ -25,11 +31,22 @@ SocketPool::SocketPool(size_t count, Service service, Domain domain, Type type,
     m_type(type),
     m_options(options)
 {
-    m_fds = new struct pollfd[count] { };
+    // the extra entry wakes up the poll when a socket has to be polled for writing
+    m_fds = new struct pollfd[count + 1] { };
+    m_pollWrite = new std::atomic<bool>[count];
     for(auto i = 0;i < count;i ++)
     {
         m_fds[i].fd = (-1);
+        m_pollWrite[i] = false;
     }
+    if(m_service == Service::Server)
+    {
+        m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+    m_fds[count].fd = m_wakeFd;
+    m_fds[count].events = POLLIN;
+    // the writes are serialized per connection so a slow client doesn't hold up the others
+    m_writeMutex = new Mutex[count];
 #ifdef WITH_OPENSSL
     if(IsContains(m_options, Options::Ssl))
     {
@@ -45,6 +62,21 @@ SocketPool::~SocketPool()
         delete []m_fds;
         m_fds = nullptr;
     }
+    if(m_writeMutex != nullptr)
+    {
+        delete []m_writeMutex;
+        m_writeMutex = nullptr;
+    }
+    if(m_pollWrite != nullptr)
+    {
+        delete []m_pollWrite;
+        m_pollWrite = nullptr;
+    }
+    if(m_wakeFd != (-1))
+    {
+        close(m_wakeFd);
+        m_wakeFd = (-1);
+    }
 #ifdef WITH_OPENSSL
     if(IsContains(m_options, Options::Ssl))
     {
@@ -149,6 +181,8 @@ bool SocketPool::CloseSocket(size_t index)
             close(m_fds[index].fd);
             m_fds[index].fd = (-1);
             m_fds[index].events = 0;
+            m_fds[index].revents = 0;
+            m_pollWrite[index] = false;
 #ifdef WITH_OPENSSL
             if(IsContains(m_options, Options::Ssl))
             {
@@ -292,6 +326,9 @@ size_t SocketPool::Accept()
                 fcntl(new_socket, F_SETFL, O_NONBLOCK);
                 m_fds[index].fd = new_socket;
                 m_fds[index].events = POLLIN;
+                // the slot could be closed from another thread, drop the events left from the previous socket
+                m_fds[index].revents = 0;
+                m_pollWrite[index] = false;
 #ifdef WITH_OPENSSL
                 if(IsContains(m_options, Options::Ssl))
                 {
@@ -484,7 +521,7 @@ bool SocketPool::ConnectUnix(const std::string &host)
 size_t SocketPool::Write(const uint8_t *buffer, size_t size, size_t index)
 {
     ClearError();
-    Lock lock(m_writeMutex);
+    Lock lock(m_writeMutex[index]);
 
     size_t total = 0;
     try
@@ -511,6 +548,7 @@ size_t SocketPool::Write(const uint8_t *buffer, size_t size, size_t index)
                     int errorCode = SSL_get_error(ssl, sent);
                     if(errorCode == SSL_ERROR_WANT_WRITE)
                     {
+                        WaitForWrite(fd);
                         again = true;
                     }
                     else
@@ -545,6 +583,7 @@ size_t SocketPool::Write(const uint8_t *buffer, size_t size, size_t index)
                 {
                     if(errno == EAGAIN)
                     {
+                        WaitForWrite(fd);
                         again = true;
                     }
                     else
@@ -580,6 +619,260 @@ size_t SocketPool::Write(const uint8_t *buffer, size_t size, size_t index)
     return total;
 }
 
+size_t SocketPool::WriteV(const struct iovec *iov, int count, size_t index)
+{
+    size_t size = 0;
+    for(int i = 0;i < count;i ++)
+    {
+        size += iov[i].iov_len;
+    }
+
+    if(IsContains(m_options, Options::Ssl))
+    {
+        ByteArray buffer;
+        buffer.reserve(size);
+        for(int i = 0;i < count;i ++)
+        {
+            auto ptr = static_cast<const uint8_t *>(iov[i].iov_base);
+            buffer.insert(buffer.end(), ptr, ptr + iov[i].iov_len);
+        }
+        return Write(buffer.data(), buffer.size(), index);
+    }
+
+    ClearError();
+    Lock lock(m_writeMutex[index]);
+
+    size_t total = 0;
+    try
+    {
+        int fd = m_fds[index].fd;
+        if(fd == ERROR)
+        {
+            SetLastError("wrong socket");
+            return ERROR;
+        }
+
+        std::vector<struct iovec> vector(iov, iov + count);
+        size_t current = 0;
+        while(total < size)
+        {
+            struct msghdr message = {};
+            message.msg_iov = vector.data() + current;
+            message.msg_iovlen = vector.size() - current;
+            ssize_t sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+            if(sent == ERROR)
+            {
+                if(errno == EAGAIN)
+                {
+                    WaitForWrite(fd);
+                    continue;
+                }
+
+                throw std::runtime_error(std::string("socket write error: ") + strerror(errno));
+            }
+
+            total += sent;
+            size_t bytes = sent;
+            while(current < vector.size() && bytes >= vector[current].iov_len)
+            {
+                bytes -= vector[current].iov_len;
+                current ++;
+            }
+            if(current < vector.size())
+            {
+                vector[current].iov_base = static_cast<uint8_t *>(vector[current].iov_base) + bytes;
+                vector[current].iov_len -= bytes;
+            }
+        }
+    }
+    catch(const std::runtime_error &err)
+    {
+        SetLastError(err.what());
+    }
+    catch(...)
+    {
+        SetLastError("socket write error");
+    }
+
+    return total;
+}
+
+// writes what the socket takes now without waiting, the count of the bytes written is returned
+size_t SocketPool::WriteVNoWait(const struct iovec *iov, int count, size_t index)
+{
+    ClearError();
+
+    if(IsContains(m_options, Options::Ssl))
+    {
+#ifdef WITH_OPENSSL
+        // the retry after SSL_ERROR_WANT_WRITE starts with the same data, maybe followed by more
+        ByteArray buffer;
+        for(int i = 0;i < count;i ++)
+        {
+            auto ptr = static_cast<const uint8_t *>(iov[i].iov_base);
+            buffer.insert(buffer.end(), ptr, ptr + iov[i].iov_len);
+        }
+
+        Lock lock(m_writeMutex[index]);
+        SSL *ssl = m_sslClient[index];
+        if(m_fds[index].fd == ERROR || ssl == nullptr)
+        {
+            SetLastError("wrong socket");
+            return ERROR;
+        }
+        int sent = SSL_write(ssl, buffer.data(), buffer.size());
+        if(sent > 0)
+        {
+            return sent;
+        }
+        int errorCode = SSL_get_error(ssl, sent);
+        if(errorCode == SSL_ERROR_WANT_WRITE)
+        {
+            return 0;
+        }
+        SetLastError(ERR_error_string(errorCode, nullptr));
+#else
+        SetLastError("SSL isn't supported");
+#endif
+        return ERROR;
+    }
+
+    Lock lock(m_writeMutex[index]);
+
+    int fd = m_fds[index].fd;
+    if(fd == ERROR)
+    {
+        SetLastError("wrong socket");
+        return ERROR;
+    }
+
+    struct msghdr message = {};
+    message.msg_iov = const_cast<struct iovec *>(iov);
+    message.msg_iovlen = count;
+    ssize_t sent;
+    do
+    {
+        sent = sendmsg(fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+    while(sent == ERROR && errno == EINTR);
+
+    if(sent == ERROR)
+    {
+        if(errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return 0;
+        }
+        SetLastError(std::string("socket write error: ") + strerror(errno), errno);
+        return ERROR;
+    }
+
+    return sent;
+}
+
+size_t SocketPool::SendFile(int fileFd, size_t offset, size_t size, size_t index)
+{
+    if(IsContains(m_options, Options::Ssl))
+    {
+        // the data has to pass through SSL_write so there is no way to avoid the copy
+        ByteArray buffer(SENDFILE_BUFFER_SIZE);
+        size_t total = 0;
+        while(total < size)
+        {
+            size_t chunk = std::min(size - total, buffer.size());
+            ssize_t bytes = pread(fileFd, buffer.data(), chunk, offset + total);
+            if(bytes <= 0)
+            {
+                SetLastError(std::string("file read error: ") + strerror(errno));
+                break;
+            }
+            size_t sent = Write(buffer.data(), bytes, index);
+            if(sent == ERROR)
+            {
+                break;
+            }
+            total += sent;
+            if(sent != static_cast<size_t>(bytes))
+            {
+                break;
+            }
+        }
+        return total;
+    }
+
+    ClearError();
+    Lock lock(m_writeMutex[index]);
+
+    size_t total = 0;
+    try
+    {
+        int fd = m_fds[index].fd;
+        if(fd == ERROR)
+        {
+            SetLastError("wrong socket");
+            return ERROR;
+        }
+
+        off_t position = offset;
+        while(total < size)
+        {
+            ssize_t sent = sendfile(fd, fileFd, &position, size - total);
+            if(sent == ERROR)
+            {
+                if(errno == EAGAIN)
+                {
+                    WaitForWrite(fd);
+                    continue;
+                }
+                if(errno == EINTR)
+                {
+                    continue;
+                }
+
+                throw std::runtime_error(std::string("socket write error: ") + strerror(errno));
+            }
+            if(sent == 0)
+            {
+                throw std::runtime_error("unexpected end of file");
+            }
+
+            total += sent;
+        }
+    }
+    catch(const std::runtime_error &err)
+    {
+        SetLastError(err.what());
+    }
+    catch(...)
+    {
+        SetLastError("socket write error");
+    }
+
+    return total;
+}
+
+void SocketPool::WaitForWrite(int fd)
+{
+    // the output buffer of the socket is full, wait until the peer reads something
+    struct pollfd pfd = {};
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+    int retval;
+    do
+    {
+        retval = poll(&pfd, 1, WRITE_TIMEOUT);
+    }
+    while(retval == ERROR && errno == EINTR);
+
+    if(retval == 0)
+    {
+        throw std::runtime_error("socket write timeout");
+    }
+    if(retval == ERROR || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)))
+    {
+        throw std::runtime_error("socket write error: connection lost");
+    }
+}
+
 size_t SocketPool::Read(void *buffer, size_t size, size_t index)
 {
     ClearError();
@@ -673,20 +966,65 @@ void SocketPool::SetPollWrite()
     }
 }
 
+// the socket is polled for writing until it's writable once, the poll is woken up to start that at once
+void SocketPool::PollWritable(size_t index)
+{
+    if(index < m_count)
+    {
+        m_pollWrite[index] = true;
+        if(m_wakeFd != (-1))
+        {
+            uint64_t value = 1;
+            ssize_t bytes = write(m_wakeFd, &value, sizeof(value));
+            (void)bytes;
+        }
+    }
+}
+
 bool SocketPool::Poll()
 {
-    auto retval = poll(m_fds, m_count, POLL_TIMEOUT);
+    for(size_t i = 0;i < m_count;i ++)
+    {
+        if(m_fds[i].fd != (-1))
+        {
+            m_fds[i].events = (m_fds[i].events & ~POLLOUT) | (m_pollWrite[i] ? POLLOUT : 0);
+        }
+    }
+
+    auto retval = poll(m_fds, m_count + 1, POLL_TIMEOUT);
+    if(retval > 0)
+    {
+        if(m_fds[m_count].revents & POLLIN)
+        {
+            uint64_t value;
+            ssize_t bytes = read(m_wakeFd, &value, sizeof(value));
+            (void)bytes;
+        }
+        for(size_t i = 0;i < m_count;i ++)
+        {
+            if(m_fds[i].revents & POLLOUT)
+            {
+                m_pollWrite[i] = false;
+            }
+        }
+    }
+
     return (retval > 0);
 }
 
 bool SocketPool::HasData(size_t index) const
 {
-    return (m_fds[index].revents == POLLIN);
+    return ((m_fds[index].revents & ~POLLOUT) == POLLIN);
+}
+
+bool SocketPool::IsWritable(size_t index) const
+{
+    return (m_fds[index].revents & POLLOUT) != 0;
 }
 
 bool SocketPool::IsPollError(size_t index) const
 {
-    auto ev = m_fds[index].revents;
+    auto ev = m_fds[index].revents & ~POLLOUT;
     return ev == POLLERR || ev == POLLHUP || ev == POLLNVAL;
 }
 
@@ -779,6 +1117,12 @@ bool SocketPool::InitSSL()
             m_ctx = SSL_CTX_new(method);
         }
 
+        // the non-blocking write is retried from a buffer that is built again
+        if(m_ctx != nullptr)
+        {
+            SSL_CTX_set_mode(m_ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+        }
+
         if(m_ctx == nullptr)
         {
             SetLastError(ERR_error_string(ERR_get_error(), nullptr));
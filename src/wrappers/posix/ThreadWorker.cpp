@@ -24,27 +24,29 @@ bool ThreadWorker::Start()
         return true;
     }
 
+    // the previous thread could be still finishing
+    Wait();
+
     ClearError();
     m_isRunning = true;
 
     if(pthread_create(&m_thread, nullptr, ThreadWorker::StartThread, this) != 0)
     {
+        m_isRunning = false;
         SetLastError("failed to starting a thread");
         return false;
     }
+    m_joinable = true;
 
     return true;
 }
 
 void ThreadWorker::Stop(bool wait)
 {
-    if(m_isRunning)
+    m_isRunning = false;
+    if(wait)
     {
-        m_isRunning = false;
-        if(wait)
-        {
-            pthread_join(m_thread, nullptr);
-        }
+        Wait();
     }
 }
 
@@ -53,11 +55,13 @@ void ThreadWorker::StopNoWait()
     m_isRunning = false;
 }
 
+// the thread is joined even if it's already asked to stop, it's not done yet
 void ThreadWorker::Wait() const
 {
-    if(m_isRunning)
+    if(m_joinable && pthread_equal(m_thread, pthread_self()) == 0)
     {
         pthread_join(m_thread, nullptr);
+        m_joinable = false;
     }
 }
 